@@ -0,0 +1,63 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../src/include/utils.h"
+#include "bench.h"
+
+static volatile long sink;
+
+/* Private functions prototypes */
+static int compare_double(const void *a, const void *b);
+
+void bench_print_header(const char *suite)
+{
+	dprintf(1, "\n# %s (%d repetitions)\n", suite, BENCH_REPETITIONS);
+	dprintf(1, "%-40s %10s %12s %12s %12s %8s\n",
+		"benchmark", "ops", "min ns/op", "median ns/op", "mean ns/op", "rsd %");
+}
+
+double bench_run(const char *name, bench_fn fn, void *arg, long iterations)
+{
+	double samples[BENCH_REPETITIONS];
+	double mean, variance;
+	unsigned long start_ns;
+	int i;
+
+	/* Warm up caches, allocators and page tables */
+	fn(arg, iterations);
+
+	for (i = 0; i < BENCH_REPETITIONS; i++) {
+		start_ns = get_time_ns();
+		fn(arg, iterations);
+		samples[i] = (get_time_ns() - start_ns) / (double)iterations;
+	}
+
+	for (i = 0, mean = 0; i < BENCH_REPETITIONS; i++)
+		mean += samples[i];
+	mean /= BENCH_REPETITIONS;
+	for (i = 0, variance = 0; i < BENCH_REPETITIONS; i++)
+		variance += (samples[i] - mean) * (samples[i] - mean);
+	variance /= BENCH_REPETITIONS;
+
+	qsort(samples, BENCH_REPETITIONS, sizeof(double), compare_double);
+
+	dprintf(1, "%-40s %10ld %12.1f %12.1f %12.1f %8.1f\n", name, iterations,
+		samples[0], samples[BENCH_REPETITIONS / 2], mean,
+		mean > 0 ? sqrt(variance) / mean * 100 : 0);
+
+	return samples[BENCH_REPETITIONS / 2];
+}
+
+void bench_consume(long value)
+{
+	sink += value;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
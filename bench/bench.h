@@ -0,0 +1,46 @@
+/**
+* @file bench.h
+* @brief Minimal harness for timed and repeatable micro-benchmarks.
+*
+* Every benchmark is run once to warm up, then BENCH_REPETITIONS times.
+* The reported statistics are computed on the ns/op of every repetition.
+*/
+
+#ifndef OS_PROJECT_BENCH_H
+#define OS_PROJECT_BENCH_H
+
+#define BENCH_REPETITIONS 15
+
+/**
+ * @brief Benchmark body.
+ * @param arg argument passed to bench_run().
+ * @param iterations number of operations to execute.
+ */
+typedef void (*bench_fn)(void *arg, long iterations);
+
+/**
+* @brief Prints the header of the result table.
+*
+* @param suite name of the benchmark suite.
+*/
+void bench_print_header(const char *suite);
+
+/**
+* @brief Runs a benchmark and prints one row of statistics.
+*
+* @param name name of the benchmark.
+* @param fn the benchmark body.
+* @param arg argument passed to the body.
+* @param iterations number of operations executed by every repetition.
+* @return the median ns/op.
+*/
+double bench_run(const char *name, bench_fn fn, void *arg, long iterations);
+
+/**
+* @brief Prevents the compiler from removing computations whose result is unused.
+*
+* @param value the value to consume.
+*/
+void bench_consume(long value);
+
+#endif
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/include/cargo_list.h"
+#include "bench.h"
+
+#define ITERATIONS 200000
+
+struct list_arg {
+	o_list_t *list;
+	int lots;
+	int next_expire;
+};
+
+/* Benchmarks */
+static void bench_add(void *arg, long iterations);
+static void bench_pop_needed(void *arg, long iterations);
+static void bench_consume_lots(void *arg, long iterations);
+static void count_lot(int quantity, int expire, bool_t last, void *arg);
+static void bench_get_not_expired(void *arg, long iterations);
+
+static void fill_list(struct list_arg *arg, int lots);
+static void print_pool_stats(void);
+
+int main(int argc, char *argv[])
+{
+	int sizes[] = { 10, 100, 1000 };
+	char name[64];
+	struct list_arg arg;
+	int i;
+
+	srandom(1);
+	bench_print_header("cargo_list");
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		arg.lots = sizes[i];
+
+		sprintf(name, "cargo_list_add (%d lots)", sizes[i]);
+		bench_run(name, bench_add, &arg, ITERATIONS);
+
+		fill_list(&arg, sizes[i]);
+		sprintf(name, "cargo_list_pop_needed (%d lots)", sizes[i]);
+		bench_run(name, bench_pop_needed, &arg, ITERATIONS);
+		cargo_list_delete(arg.list);
+
+		fill_list(&arg, sizes[i]);
+		sprintf(name, "cargo_list_consume (%d lots)", sizes[i]);
+		bench_run(name, bench_consume_lots, &arg, ITERATIONS);
+		cargo_list_delete(arg.list);
+
+		fill_list(&arg, sizes[i]);
+		sprintf(name, "cargo_list_get_not_expired (%d lots)", sizes[i]);
+		bench_run(name, bench_get_not_expired, &arg, ITERATIONS / 10);
+		cargo_list_delete(arg.list);
+	}
+	print_pool_stats();
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Adds lots with random expiration into lists of arg->lots lots,
+ * 	the list is recreated when full.
+ */
+static void bench_add(void *arg, long iterations)
+{
+	struct list_arg *a = arg;
+	o_list_t *list;
+	long i;
+
+	list = cargo_list_create();
+	for (i = 0; i < iterations; i++) {
+		if (i % a->lots == 0) {
+			cargo_list_delete(list);
+			list = cargo_list_create();
+		}
+		cargo_list_add(list, 10, (int)(random() % (a->lots * 4)));
+	}
+	cargo_list_delete(list);
+}
+
+/**
+ * @brief Steady state of a port: one lot is generated and the oldest one is sold.
+ */
+static void bench_pop_needed(void *arg, long iterations)
+{
+	struct list_arg *a = arg;
+	long i;
+
+	for (i = 0; i < iterations; i++) {
+		cargo_list_add(a->list, 10, a->next_expire++);
+		cargo_list_delete(cargo_list_pop_needed(a->list, 10));
+	}
+}
+
+static void count_lot(int quantity, int expire, bool_t last, void *arg)
+{
+	bench_consume(quantity + expire);
+}
+
+/**
+ * @brief Same steady state of bench_pop_needed() using the in place consumption.
+ */
+static void bench_consume_lots(void *arg, long iterations)
+{
+	struct list_arg *a = arg;
+	long i;
+
+	for (i = 0; i < iterations; i++) {
+		cargo_list_add(a->list, 10, a->next_expire++);
+		cargo_list_consume(a->list, 10, count_lot, NULL);
+	}
+}
+
+static void bench_get_not_expired(void *arg, long iterations)
+{
+	struct list_arg *a = arg;
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		bench_consume(cargo_list_get_not_expired_by_day(a->list, (int)(i % a->lots)));
+}
+
+static void fill_list(struct list_arg *arg, int lots)
+{
+	arg->list = cargo_list_create();
+	for (arg->next_expire = 0; arg->next_expire < lots; arg->next_expire++)
+		cargo_list_add(arg->list, 10, arg->next_expire);
+}
+
+static void print_pool_stats(void)
+{
+	struct cargo_list_pool_stats stats;
+
+	cargo_list_pool_get_stats(&stats);
+	dprintf(1, "pool: %lu allocations served by %lu slabs, %lu items in use\n",
+		stats.allocations, stats.slabs, stats.in_use);
+}
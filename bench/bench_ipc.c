@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/msg.h>
+
+#include "../lib/semaphore.h"
+#include "../src/include/msg_commerce.h"
+#include "bench.h"
+
+#define ITERATIONS 100000
+#define CONTENDING_PROCESSES 4
+
+struct sem_arg {
+	int sem_id;
+	int processes;
+};
+
+/* Benchmarks */
+static void bench_semop(void *arg, long iterations);
+static void bench_semop_contended(void *arg, long iterations);
+static void bench_msg_ping_pong(void *arg, long iterations);
+
+static void lock_unlock(int sem_id, long iterations);
+static pid_t start_echo(int queue_id);
+
+int main(int argc, char *argv[])
+{
+	struct sem_arg sem;
+	int queue_id;
+	pid_t echo;
+
+	bench_print_header("ipc");
+
+	sem.sem_id = sem_create(IPC_PRIVATE, 1);
+	sem_setval(sem.sem_id, 0, 1);
+	bench_run("sem_execute_semop lock+unlock", bench_semop, &sem, ITERATIONS);
+	sem.processes = CONTENDING_PROCESSES;
+	bench_run("sem_execute_semop lock+unlock (4 procs)", bench_semop_contended, &sem, ITERATIONS);
+	sem_delete(sem.sem_id);
+
+	queue_id = msgget(IPC_PRIVATE, 0660 | IPC_CREAT);
+	echo = start_echo(queue_id);
+	bench_run("msg_commerce send+receive ping-pong", bench_msg_ping_pong, &queue_id, ITERATIONS / 2);
+	kill(echo, SIGKILL);
+	waitpid(echo, NULL, 0);
+	msgctl(queue_id, IPC_RMID, NULL);
+
+	return EXIT_SUCCESS;
+}
+
+static void bench_semop(void *arg, long iterations)
+{
+	lock_unlock(((struct sem_arg *)arg)->sem_id, iterations);
+}
+
+/**
+ * @brief The operations are split between processes fighting for the same semaphore.
+ */
+static void bench_semop_contended(void *arg, long iterations)
+{
+	struct sem_arg *a = arg;
+	int i;
+
+	for (i = 0; i < a->processes; i++) {
+		if (fork() == 0) {
+			lock_unlock(a->sem_id, iterations / a->processes);
+			exit(EXIT_SUCCESS);
+		}
+	}
+	while (wait(NULL) > 0);
+}
+
+/**
+ * @brief One operation is a full round trip: ping to the echo process and back.
+ */
+static void bench_msg_ping_pong(void *arg, long iterations)
+{
+	struct commerce_msg msg;
+	int queue_id = *(int *)arg;
+	int quantity;
+	long i;
+
+	for (i = 0; i < iterations; i++) {
+		msg = msg_commerce_create(0, 1, 0, (int)i, -1, STATUS_SELL);
+		msg_commerce_send(queue_id, &msg);
+		msg_commerce_receive(queue_id, 1, NULL, NULL, &quantity, NULL, NULL, TRUE);
+	}
+}
+
+static void lock_unlock(int sem_id, long iterations)
+{
+	long i;
+
+	for (i = 0; i < iterations; i++) {
+		sem_execute_semop(sem_id, 0, -1, 0);
+		sem_execute_semop(sem_id, 0, 1, 0);
+	}
+}
+
+static pid_t start_echo(int queue_id)
+{
+	struct commerce_msg msg;
+	int quantity;
+	pid_t pid;
+
+	if ((pid = fork()) == 0) {
+		while (1) {
+			msg_commerce_receive(queue_id, 0, NULL, NULL, &quantity, NULL, NULL, TRUE);
+			msg = msg_commerce_create(1, 0, 0, quantity, -1, STATUS_ACCEPTED);
+			msg_commerce_send(queue_id, &msg);
+		}
+	}
+	return pid;
+}
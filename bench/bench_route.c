@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/msg.h>
+
+#include "../lib/semaphore.h"
+#include "../src/include/utils.h"
+#include "../src/include/shm_general.h"
+#include "../src/include/shm_port.h"
+#include "../src/include/shm_cargo.h"
+#include "../src/include/shm_offer_demand.h"
+#include "../src/include/cargo_list.h"
+#include "../src/include/route.h"
+#include "bench.h"
+
+#define ITERATIONS 2000
+#define LOTS_PER_TYPE 5
+
+struct route_arg {
+	shm_general_t *general;
+	shm_port_t *ports;
+	shm_offer_t *offer;
+	shm_cargo_t *cargo;
+	shm_demand_t *demand;
+	o_list_t **cargo_hold;
+	struct coord position;
+};
+
+static void bench_find_best_port(void *arg, long iterations);
+static void bench_plan(void *arg, long iterations);
+static void bench_plan_cached(void *arg, long iterations);
+
+static void setup_market(struct route_arg *arg, shm_cargo_t *cargo, shm_offer_t *offer);
+static void cleanup(struct route_arg *arg);
+
+int main(int argc, char *argv[])
+{
+	struct route_arg arg;
+	shm_cargo_t *cargo;
+	shm_offer_t *offer;
+	char name[64];
+	int i, j;
+
+	srandom(1);
+	arg.general = read_from_path(argc > 1 ? argv[1] : "constants.txt", &arg.general);
+	if (arg.general == NULL) {
+		dprintf(2, "bench_route.c: Failed to read configuration.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (shm_general_ipc_init(arg.general) == FALSE) {
+		dprintf(2, "bench_route.c: Failed to create the semaphores and queues.\n");
+		shm_general_delete(shm_general_get_id(arg.general));
+		exit(EXIT_FAILURE);
+	}
+	arg.ports = shm_port_initialize(arg.general);
+	shm_port_ipc_init(arg.general, arg.ports);
+	cargo = shm_cargo_initialize(arg.general);
+	offer = shm_offer_init(arg.general);
+	arg.demand = shm_demand_init(arg.general, offer);
+	setup_market(&arg, cargo, offer);
+
+	/* A ship carrying a few lots of every type */
+	arg.cargo_hold = malloc(sizeof(*arg.cargo_hold) * get_merci(arg.general));
+	for (i = 0; i < get_merci(arg.general); i++) {
+		arg.cargo_hold[i] = cargo_list_create();
+		for (j = 0; j < LOTS_PER_TYPE; j++)
+			cargo_list_add(arg.cargo_hold[i], RANDOM_INTEGER(1, 20),
+				       RANDOM_INTEGER(0, get_max_vita(arg.general)));
+	}
+	arg.position.x = RANDOM_DOUBLE(0, get_lato(arg.general));
+	arg.position.y = RANDOM_DOUBLE(0, get_lato(arg.general));
+
+	bench_print_header("route");
+	sprintf(name, "route_find_best_port (%d ports, %d types)",
+		get_porti(arg.general), get_merci(arg.general));
+	bench_run(name, bench_find_best_port, &arg, ITERATIONS);
+	arg.offer = offer;
+	arg.cargo = cargo;
+	sprintf(name, "route_plan (%d ports, %d types)",
+		get_porti(arg.general), get_merci(arg.general));
+	bench_run(name, bench_plan, &arg, ITERATIONS / 10);
+	sprintf(name, "route_plan cached (%d ports, %d types)",
+		get_porti(arg.general), get_merci(arg.general));
+	bench_run(name, bench_plan_cached, &arg, ITERATIONS);
+	route_plan_destroy();
+
+	for (i = 0; i < get_merci(arg.general); i++)
+		cargo_list_delete(arg.cargo_hold[i]);
+	free(arg.cargo_hold);
+	shm_offer_detach(offer);
+	shm_cargo_detach(cargo);
+	cleanup(&arg);
+
+	return EXIT_SUCCESS;
+}
+
+static void bench_find_best_port(void *arg, long iterations)
+{
+	struct route_arg *a = arg;
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		bench_consume(route_find_best_port(a->general, a->ports, a->demand, a->cargo_hold,
+						   a->position, (int)(i % get_porti(a->general))));
+}
+
+/**
+ * @brief Every call has a different free capacity, so the cache never hits.
+ */
+static void bench_plan(void *arg, long iterations)
+{
+	struct route_arg *a = arg;
+	static long calls;
+	long i;
+
+	for (i = 0; i < iterations; i++, calls++)
+		bench_consume(route_plan(a->general, a->ports, a->offer, a->demand, a->cargo, a->cargo_hold,
+					 (int)calls, a->position, (int)(calls % get_porti(a->general))));
+}
+
+/**
+ * @brief Same port and hold at every call.
+ */
+static void bench_plan_cached(void *arg, long iterations)
+{
+	struct route_arg *a = arg;
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		bench_consume(route_plan(a->general, a->ports, a->offer, a->demand, a->cargo, a->cargo_hold,
+					 get_capacity(a->general), a->position, 0));
+}
+
+/**
+ * @brief Places the ports and runs the first day of offer/demand generation.
+ */
+static void setup_market(struct route_arg *arg, shm_cargo_t *cargo, shm_offer_t *offer)
+{
+	o_list_t **lists;
+	struct coord coord;
+	int port, type, n_cargo;
+
+	n_cargo = get_merci(arg->general);
+	lists = malloc(sizeof(*lists) * n_cargo);
+	for (port = 0; port < get_porti(arg->general); port++) {
+		coord.x = RANDOM_DOUBLE(0, get_lato(arg->general));
+		coord.y = RANDOM_DOUBLE(0, get_lato(arg->general));
+		shm_port_set_coordinates(arg->ports, port, coord);
+
+		for (type = 0; type < n_cargo; type++)
+			lists[type] = cargo_list_create();
+		shm_offer_demand_generate(offer, arg->demand, lists, port, cargo, arg->general);
+		for (type = 0; type < n_cargo; type++)
+			cargo_list_delete(lists[type]);
+	}
+	free(lists);
+}
+
+static void cleanup(struct route_arg *arg)
+{
+	shm_general_t *g = arg->general;
+	int i;
+
+	shm_general_ipc_delete(g);
+	sem_delete(shm_port_get_sem_docks_id(arg->ports));
+
+	shm_port_delete(g);
+	shm_offer_demand_delete(g);
+	shm_cargo_delete(g);
+	shm_port_detach(arg->ports);
+	shm_demand_detach(arg->demand);
+	shm_general_delete(shm_general_get_id(g));
+	shm_general_detach(g);
+}
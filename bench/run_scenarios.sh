@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# End-to-end scaling benchmark over the cases/ scenarios.
+#
+# Every scenario is run once for each multiplier: SO_NAVI, SO_PORTI and
+# SO_MERCI are multiplied by it. The SUMMARY line printed by the master at
+# the end of the run is collected into a comparison table.
+#
+# Environment:
+#   MULT   space separated multipliers (default: "1")
+#   DAYS   overrides SO_DAYS of every scenario (default: keep the scenario's)
+#   CASES  scenario files (default: cases/*.txt)
+#   OUT    output table (default: bench_scenarios.txt)
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+MULT=${MULT:-1}
+CASES=${CASES:-$(ls "$ROOT"/cases/*.txt)}
+OUT=${OUT:-$ROOT/bench_scenarios.txt}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# scale_config <input> <multiplier> <output>
+scale_config() {
+	awk -v mult="$2" -v days="$DAYS" '
+	/^[ \t]*SO_[A-Z_]+[ \t]*=/ {
+		key = substr($0, 1, index($0, "=") - 1)
+		gsub(/[ \t]/, "", key)
+		split(substr($0, index($0, "=") + 1), v, " ")
+		if (key ~ /^SO_(NAVI|PORTI|MERCI)$/)
+			v[1] = int(v[1] * mult)
+		if (key == "SO_DAYS" && days != "")
+			v[1] = days
+		print key "=" v[1]
+		next
+	}
+	/SO_NAVI|SO_PORTI|SO_MERCI/ { $1 = int($1 * mult) }
+	/SO_DAYS/ && days != "" { $1 = days }
+	{ print }' "$1" > "$3"
+}
+
+# field <summary line> <key>
+field() {
+	echo "$1" | tr ' ' '\n' | sed -n "s/^$2=//p"
+}
+
+if [ ! -x "$ROOT/bin/master" ]; then
+	echo "run_scenarios.sh: build the simulation first (make)." >&2
+	exit 1
+fi
+
+printf "%-16s %5s %8s %8s %8s %10s %10s %10s %10s %12s\n" \
+	scenario mult wall_s user_s sys_s ctx_sw rss_kb trades/s msgs/s trades > "$OUT"
+
+for case in $CASES; do
+	name=$(basename "$case" .txt)
+	for mult in $MULT; do
+		config="$TMP/$name-$mult.txt"
+		scale_config "$case" "$mult" "$config"
+		summary=$(cd "$ROOT/bin" && ./master "$config" | grep '^SUMMARY')
+		if [ -z "$summary" ]; then
+			echo "run_scenarios.sh: $name x$mult did not complete." >&2
+			continue
+		fi
+		printf "%-16s %5s %8s %8s %8s %10s %10s %10s %10s %12s\n" "$name" "$mult" \
+			"$(field "$summary" wall_s)" "$(field "$summary" user_s)" \
+			"$(field "$summary" sys_s)" "$(field "$summary" ctx_switches)" \
+			"$(field "$summary" peak_rss_kb)" "$(field "$summary" trades_per_s)" \
+			"$(field "$summary" msgs_per_s)" "$(field "$summary" trades)" >> "$OUT"
+	done
+done
+
+cat "$OUT"
@@ -0,0 +1,110 @@
+#include <math.h>
+#include <string.h>
+
+#include "histogram.h"
+
+/* Private functions prototypes */
+static int get_bucket_index(unsigned long value);
+static unsigned long get_bucket_highest(int index);
+
+void histogram_reset(struct histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+void histogram_record(struct histogram *h, unsigned long value)
+{
+	if (h->count == 0 || value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+	h->count++;
+	h->sum += (double)value;
+	h->buckets[get_bucket_index(value)]++;
+}
+
+void histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+	int i;
+
+	if (src->count == 0)
+		return;
+
+	if (dst->count == 0 || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+unsigned long histogram_percentile(const struct histogram *h, double percentile)
+{
+	unsigned long target, seen;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	/* Nearest rank: the smallest value with at least percentile % of the samples at or below it */
+	target = (unsigned long)ceil(h->count * percentile / 100.0);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0, seen = 0; i < HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target)
+			return get_bucket_highest(i) < h->max ? get_bucket_highest(i) : h->max;
+	}
+	return h->max;
+}
+
+double histogram_mean(const struct histogram *h)
+{
+	return h->count == 0 ? 0 : h->sum / h->count;
+}
+
+/**
+ * @brief Private function that maps a value to its bucket.
+ *
+ * Values lower than HIST_SUB_COUNT have a bucket each, then every power of
+ * two is split in HIST_SUB_COUNT buckets of equal width.
+ *
+ * @param value the value.
+ * @return the index of the bucket.
+ */
+static int get_bucket_index(unsigned long value)
+{
+	int msb, shift;
+
+	if (value < HIST_SUB_COUNT)
+		return (int)value;
+
+	for (msb = 0; (value >> msb) > 1; msb++);
+	if (msb >= HIST_VALUE_BITS)
+		return HIST_BUCKETS - 1;
+
+	shift = msb - HIST_SUB_BITS;
+	return ((shift + 1) << HIST_SUB_BITS) + (int)((value >> shift) - HIST_SUB_COUNT);
+}
+
+/**
+ * @brief Private function that returns the highest value stored in a bucket.
+ *
+ * @param index the index of the bucket.
+ * @return the highest value mapped to the bucket.
+ */
+static unsigned long get_bucket_highest(int index)
+{
+	int shift;
+	unsigned long mantissa;
+
+	if (index < HIST_SUB_COUNT)
+		return (unsigned long)index;
+
+	shift = (index >> HIST_SUB_BITS) - 1;
+	mantissa = (unsigned long)(index & (HIST_SUB_COUNT - 1)) + HIST_SUB_COUNT;
+	return ((mantissa + 1) << shift) - 1;
+}
@@ -0,0 +1,73 @@
+/**
+* @file histogram.h
+* @brief Library that provides log-bucketed (HDR-style) histograms with a fixed memory footprint.
+*
+* Values are stored in buckets whose width grows with the magnitude of the value, so the
+* relative error stays bounded (about 1 / HIST_SUB_COUNT) over the whole range.
+* The structure holds no pointers and can be placed in shared memory.
+*/
+
+#ifndef OS_PROJECT_HISTOGRAM_H
+#define OS_PROJECT_HISTOGRAM_H
+
+/**
+ * @brief Number of bits used to split every power of two in sub-buckets.
+ */
+#define HIST_SUB_BITS 3
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+
+/**
+ * @brief Values are tracked up to 2^HIST_VALUE_BITS, bigger values are clamped.
+ */
+#define HIST_VALUE_BITS 40
+#define HIST_BUCKETS ((HIST_VALUE_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+struct histogram {
+	unsigned long count;
+	unsigned long min;
+	unsigned long max;
+	double sum;
+	unsigned int buckets[HIST_BUCKETS];
+};
+
+/**
+* @brief Empties the histogram.
+*
+* @param h the histogram.
+*/
+void histogram_reset(struct histogram *h);
+
+/**
+* @brief Records a value in the histogram.
+*
+* @param h the histogram.
+* @param value the value to record.
+*/
+void histogram_record(struct histogram *h, unsigned long value);
+
+/**
+* @brief Adds all the values recorded in src to dst.
+*
+* @param dst the destination histogram.
+* @param src the source histogram.
+*/
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+
+/**
+* @brief Returns the value at the given percentile.
+*
+* @param h the histogram.
+* @param percentile the percentile, between 0 and 100.
+* @return the highest value equivalent to the bucket containing the percentile, 0 if empty.
+*/
+unsigned long histogram_percentile(const struct histogram *h, double percentile);
+
+/**
+* @brief Returns the mean of the recorded values.
+*
+* @param h the histogram.
+* @return the mean, 0 if empty.
+*/
+double histogram_mean(const struct histogram *h);
+
+#endif
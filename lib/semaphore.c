@@ -1,5 +1,6 @@
 #define _GNU_SOURCE
 
+#include <errno.h>
 #include <stdio.h>
 #include "semaphore.h"
 
@@ -20,6 +21,19 @@ int sem_create(key_t sem_key, int nsems)
 	return res;
 }
 
+int sem_reuse(key_t sem_key, int nsems)
+{
+	struct semid_ds info;
+	int id;
+
+	if ((id = semget(sem_key, 0, 0)) != -1) {
+		if (semctl(id, 0, IPC_STAT, &info) != -1 && (int)info.sem_nsems == nsems)
+			return id;
+		sem_delete(id);
+	}
+	return sem_create(sem_key, nsems);
+}
+
 int sem_get_id(key_t key)
 {
 	int res;
@@ -50,7 +64,23 @@ void sem_execute_semop(id_t sem_id, int sem_index, int op_val, int flags)
 	struct sembuf operation;
 
 	operation = create_sembuf(sem_index, op_val, flags);
-	while(semop(sem_id, &operation, 1) == -1);
+	while (semop(sem_id, &operation, 1) == -1) {
+		if (errno != EINTR) {
+			dprintf(2, "semaphore.c - sem_execute_semop: Failed to execute the operation.\n");
+			break;
+		}
+	}
+}
+
+int sem_execute_semop_interruptible(id_t sem_id, int sem_index, int op_val, int flags)
+{
+	struct sembuf operation;
+
+	operation = create_sembuf(sem_index, op_val, flags);
+	while (semop(sem_id, &operation, 1) == -1)
+		if (errno == EINTR)
+			return -1;
+	return 0;
 }
 
 void sem_delete(id_t sem_id)
@@ -17,6 +17,16 @@
 */
 int sem_create(key_t sem_key, int nsems);
 
+/**
+* @brief Gets the semaphore array with the given key if it already exists with nsems semaphores,
+* 	otherwise it is created again. The values of the semaphores must be set by the caller.
+*
+* @param sem_key semaphore key.
+* @param nsems number of semaphores in the array.
+* @return the id of the semaphore array.
+*/
+int sem_reuse(key_t sem_key, int nsems);
+
 /**
  * @brief Get the id of an existing semaphore associated with the given key.
  *
@@ -42,7 +52,8 @@ void sem_setval(id_t sem_id, int sem_index, int value);
 int sem_getval(id_t sem_id, int sem_index);
 
 /**
-* @brief Executes a semaphore operation using semop system call.
+* @brief Executes a semaphore operation using semop system call, performed
+* 	again if a signal interrupts it.
 *
 * @param sem_id the id of the semaphore array.
 * @param sem_index the index of the semaphore in the array.
@@ -51,6 +62,17 @@ int sem_getval(id_t sem_id, int sem_index);
 */
 void sem_execute_semop(id_t sem_id, int sem_index, int op_val, int flags);
 
+/**
+* @brief Executes a semaphore operation that a signal can interrupt.
+*
+* @param sem_id the id of the semaphore array.
+* @param sem_index the index of the semaphore in the array.
+* @param op_val the operation performed on the semaphore.
+* @param flags the flags used for the operation. Use 0 for no flags.
+* @return 0 once the operation is performed, -1 if a signal interrupted it.
+*/
+int sem_execute_semop_interruptible(id_t sem_id, int sem_index, int op_val, int flags);
+
 /**
 * @brief Deletes a semaphore array.
 *
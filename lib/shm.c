@@ -9,13 +9,34 @@
 int shm_create(key_t key, size_t size)
 {
 	int res;
-	if ((res = shmget(key, size, 0660 | IPC_CREAT)) == -1) {
+	if ((res = shmget(key, size, 0660 | IPC_CREAT | IPC_EXCL)) == -1) {
 		dprintf(2, "shm.c - shm_create() : Failed to create SHM segment.\n");
 		perror("shmget");
 	}
 	return res;
 }
 
+int shm_get_id(key_t key)
+{
+	int res;
+	if ((res = shmget(key, 0, 0)) == -1) {
+		dprintf(2, "shm.c - shm_get_id() : Failed to get SHM segment.\n");
+		perror("shmget");
+	}
+	return res;
+}
+
+size_t shm_get_size(int id_shm)
+{
+	struct shmid_ds info;
+	if (shmctl(id_shm, IPC_STAT, &info) == -1) {
+		dprintf(2, "shm.c - shm_get_size() : Failed to get SHM segment info.\n");
+		perror("shmctl");
+		return 0;
+	}
+	return info.shm_segsz;
+}
+
 void shm_delete(int id_shm)
 {
 	if (shmctl(id_shm, IPC_RMID, NULL) == -1) {
@@ -14,10 +14,26 @@
 *
 * @param key the key for the shared memory.
 * @param size the size of the segment.
-* @return the id of the created segment. If segment exists with key the id of the existing segment.
+* @return the id of the created segment, -1 if a segment with key already exists.
 */
 int shm_create(key_t key, size_t size);
 
+/**
+* @brief Gets the id of an existing shared memory segment.
+*
+* @param key the key of the segment.
+* @return the id of the segment, -1 if it does not exist.
+*/
+int shm_get_id(key_t key);
+
+/**
+* @brief Gets the size of a shared memory segment.
+*
+* @param id_shm the id of the shared memory segment.
+* @return the size of the segment, 0 on failure.
+*/
+size_t shm_get_size(int id_shm);
+
 /**
 * @brief Deletes the shared memory segment.
 *
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 
+#include "include/utils.h"
 #include "include/cargo_list.h"
 
 /**
@@ -16,16 +18,53 @@ struct o_list {
 	struct node *head;
 };
 
+/**
+ * @brief Nodes and list headers are served by the same pool.
+ *
+ * 	Free items are chained through node.next, so a whole list can be
+ * 	given back to the pool by splicing it.
+ */
+union pool_item {
+	struct node node;
+	struct o_list list;
+};
+
+#define POOL_SLAB_ITEMS 256
+
+struct slab {
+	struct slab *next;
+	union pool_item items[POOL_SLAB_ITEMS];
+};
+
+/**
+ * @brief Per process pool of items.
+ */
+static struct {
+	struct node *free;
+	struct slab *slabs;
+	struct cargo_list_pool_stats stats;
+	void (*lock)(void);	/* see cargo_list_pool_set_lock() */
+	void (*unlock)(void);
+} pool;
+
+#define POOL_LOCK() do { if (pool.lock != NULL) pool.lock(); } while (0)
+#define POOL_UNLOCK() do { if (pool.unlock != NULL) pool.unlock(); } while (0)
+
 static struct node *create_node(int quantity, int expire);
+static union pool_item *pool_alloc(void);
+static void pool_free(union pool_item *item);
+static void pool_free_chain(struct node *head);
 
 o_list_t *cargo_list_create(void)
 {
+	union pool_item *item;
 	o_list_t *list;
 
-	list = calloc(1, sizeof(o_list_t));
-	if (list == NULL) {
+	item = pool_alloc();
+	if (item == NULL) {
 		return NULL;
 	}
+	list = &item->list;
 	list->head = NULL;
 
 	return list;
@@ -81,21 +120,29 @@ int cargo_list_remove_expired(o_list_t *list, int day)
 
 	qt = 0;
 
-	if (list->head->expire < day) {
-		qt = list->head->quantity;
+	/* Lots are sorted by expire, the expired ones are all at the head */
+	while (list->head != NULL && list->head->expire < day) {
+		qt += list->head->quantity;
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		pool_free((union pool_item *)tmp);
 	}
 
 	return qt;
 }
 
+int cargo_list_get_first_expire(o_list_t *list)
+{
+	if (list == NULL || list->head == NULL)
+		return INT_MAX;
+	return list->head->expire;
+}
+
 o_list_t *cargo_list_pop_needed(o_list_t *list, int quantity)
 {
 	o_list_t *output;
 
-	struct node *tmp;
+	struct node *tmp, *tail;
 	int cnt;
 
 	if (list == NULL) {
@@ -112,19 +159,29 @@ o_list_t *cargo_list_pop_needed(o_list_t *list, int quantity)
 	}
 
 	cnt = quantity;
+	tail = NULL;
 
+	/* Popped nodes are already sorted: whole nodes are moved, the last one is split */
 	while (list->head != NULL && cnt > 0) {
 		if (list->head->quantity <= cnt) {
-			cargo_list_add(output, list->head->quantity, list->head->expire);
 			cnt -= list->head->quantity;
 			tmp = list->head;
 			list->head = list->head->next;
-			free(tmp);
+			tmp->next = NULL;
 		} else {
-			cargo_list_add(output, cnt, list->head->expire);
+			tmp = create_node(cnt, list->head->expire);
+			if (tmp == NULL) {
+				break;
+			}
 			list->head->quantity -= cnt;
-			break;
+			cnt = 0;
+		}
+		if (tail == NULL) {
+			output->head = tmp;
+		} else {
+			tail->next = tmp;
 		}
+		tail = tmp;
 	}
 
 	if (list->head == NULL && cnt > 0) {
@@ -135,20 +192,53 @@ o_list_t *cargo_list_pop_needed(o_list_t *list, int quantity)
 	return output;
 }
 
-void cargo_list_delete(o_list_t *list)
+int cargo_list_consume(o_list_t *list, int quantity, cargo_list_visitor_t visitor, void *arg)
 {
-	struct node *cur, *tmp;
+	struct node *tmp;
+	int taken, cnt;
 
-	if (list == NULL) return;
+	if (list == NULL) {
+		return 0;
+	}
 
-	cur = list->head;
-	while (cur != NULL) {
-		tmp = cur;
-		cur = cur->next;
-		free(tmp);
+	cnt = quantity;
+	while (list->head != NULL && cnt > 0) {
+		tmp = list->head;
+		taken = MIN(tmp->quantity, cnt);
+		cnt -= taken;
+		if (taken == tmp->quantity) {
+			list->head = tmp->next;
+			if (visitor != NULL)
+				visitor(taken, tmp->expire, cnt == 0 || list->head == NULL, arg);
+			pool_free((union pool_item *)tmp);
+		} else {
+			tmp->quantity -= taken;
+			if (visitor != NULL)
+				visitor(taken, tmp->expire, TRUE, arg);
+		}
+	}
+
+	return quantity - cnt;
+}
+
+void cargo_list_for_each(o_list_t *list, cargo_list_visitor_t visitor, void *arg)
+{
+	struct node *cur;
+
+	if (list == NULL) {
+		return;
 	}
 
-	free(list);
+	for (cur = list->head; cur != NULL; cur = cur->next)
+		visitor(cur->quantity, cur->expire, cur->next == NULL, arg);
+}
+
+void cargo_list_delete(o_list_t *list)
+{
+	if (list == NULL) return;
+
+	pool_free_chain(list->head);
+	pool_free((union pool_item *)list);
 }
 
 void cargo_list_print_all(o_list_t *list)
@@ -177,7 +267,7 @@ void cargo_list_pop(o_list_t *list, int *quantity, int *expire_day) {
 
 	tmp = list->head;
 	list->head = list->head->next;
-	free(tmp);
+	pool_free((union pool_item *)tmp);
 }
 
 int cargo_list_get_not_expired_by_day(o_list_t *list, int expire_day) {
@@ -215,14 +305,42 @@ int cargo_list_get_quantity(o_list_t *list) {
 	return qty;
 }
 
+void cargo_list_pool_get_stats(struct cargo_list_pool_stats *stats)
+{
+	*stats = pool.stats;
+}
+
+void cargo_list_pool_set_lock(void (*lock)(void), void (*unlock)(void))
+{
+	pool.lock = lock;
+	pool.unlock = unlock;
+}
+
+void cargo_list_pool_destroy(void)
+{
+	struct slab *tmp;
+
+	while (pool.slabs != NULL) {
+		tmp = pool.slabs;
+		pool.slabs = pool.slabs->next;
+		free(tmp);
+	}
+	pool.free = NULL;
+	pool.stats.slabs = 0;
+	pool.stats.in_use = 0;
+	pool.stats.available = 0;
+}
+
 static struct node *create_node(int quantity, int expire)
 {
+	union pool_item *item;
 	struct node *node;
 
-	node = malloc(sizeof(struct node));
-	if (node == NULL) {
+	item = pool_alloc();
+	if (item == NULL) {
 		return NULL;
 	}
+	node = &item->node;
 
 	node->quantity = quantity;
 	node->expire = expire;
@@ -230,3 +348,73 @@ static struct node *create_node(int quantity, int expire)
 
 	return node;
 }
+
+/**
+ * @brief Takes an item from the pool, a new slab is allocated only when the pool is empty.
+ * @return the item or NULL if the allocation failed.
+ */
+static union pool_item *pool_alloc(void)
+{
+	union pool_item *item;
+	struct slab *slab;
+	int i;
+
+	POOL_LOCK();
+	if (pool.free == NULL) {
+		slab = malloc(sizeof(struct slab));
+		if (slab == NULL) {
+			POOL_UNLOCK();
+			return NULL;
+		}
+		slab->next = pool.slabs;
+		pool.slabs = slab;
+		for (i = 0; i < POOL_SLAB_ITEMS; i++) {
+			slab->items[i].node.next = i + 1 < POOL_SLAB_ITEMS ? &slab->items[i + 1].node : NULL;
+		}
+		pool.free = &slab->items[0].node;
+		pool.stats.slabs++;
+		pool.stats.available += POOL_SLAB_ITEMS;
+	}
+
+	item = (union pool_item *)pool.free;
+	pool.free = pool.free->next;
+	pool.stats.allocations++;
+	pool.stats.in_use++;
+	pool.stats.available--;
+	POOL_UNLOCK();
+	return item;
+}
+
+static void pool_free(union pool_item *item)
+{
+	POOL_LOCK();
+	item->node.next = pool.free;
+	pool.free = &item->node;
+	pool.stats.in_use--;
+	pool.stats.available++;
+	POOL_UNLOCK();
+}
+
+/**
+ * @brief Gives back to the pool a chain of nodes. The chain is walked once
+ * 	to find its tail and length, then spliced in with the pool locked only
+ * 	for the splice.
+ * @param head the first node of the chain.
+ */
+static void pool_free_chain(struct node *head)
+{
+	struct node *tail;
+	unsigned long cnt;
+
+	if (head == NULL) {
+		return;
+	}
+
+	for (tail = head, cnt = 1; tail->next != NULL; tail = tail->next, cnt++);
+	POOL_LOCK();
+	tail->next = pool.free;
+	pool.free = head;
+	pool.stats.in_use -= cnt;
+	pool.stats.available += cnt;
+	POOL_UNLOCK();
+}
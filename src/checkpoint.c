@@ -0,0 +1,505 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../lib/shm.h"
+#include "../lib/semaphore.h"
+
+#include "include/const.h"
+#include "include/utils.h"
+#include "include/shm_general.h"
+#include "include/shm_port.h"
+#include "include/shm_ship.h"
+#include "include/shm_cargo.h"
+#include "include/shm_offer_demand.h"
+#include "include/checkpoint.h"
+
+#define CHECKPOINT_MAGIC "SOCKPT"
+#define CHECKPOINT_VERSION 6
+#define CHECKPOINT_ALIGN 64
+#define CHECKPOINT_SPARE_LOTS 8
+
+#define ALIGN(size) (((size) + CHECKPOINT_ALIGN - 1) & ~(unsigned long)(CHECKPOINT_ALIGN - 1))
+
+enum section_type {
+	SEC_GENERAL,
+	SEC_PORTS,
+	SEC_SHIPS,
+	SEC_CARGO,
+	SEC_OFFER,
+	SEC_DEMAND,
+	SEC_HOLDS,
+	SEC_NUM
+};
+
+struct section {
+	unsigned long offset;
+	unsigned long size;
+};
+
+struct header {
+	char magic[8];
+	int version;
+	int day;
+	int n_ports, n_ships, n_cargo;
+	int lots_per_cargo;		/* lots stored for every cargo type of a hold */
+	unsigned long slot_size;	/* size of the hold of a process */
+	struct section sections[SEC_NUM];
+};
+
+/**
+ * @brief A lot of a hold, a zero quantity ends the lots of a cargo type.
+ */
+struct lot {
+	int quantity;
+	int expire;
+};
+
+/**
+ * @brief Header of the hold of a process, followed by n_cargo * lots_per_cargo lots.
+ */
+struct hold {
+	int day;	/* day of the snapshot once the hold is complete */
+	int padding;
+};
+
+/**
+ * @brief Lots of a single cargo type being saved.
+ */
+struct lot_writer {
+	struct lot *lots;
+	int n_lots, max_lots;
+	bool_t overflow;	/* set if the lots did not fit */
+};
+
+static const key_t section_keys[SEC_HOLDS] = {
+	SHM_DATA_GENERAL_KEY,
+	SHM_DATA_PORTS_KEY,
+	SHM_DATA_SHIPS_KEY,
+	SHM_DATA_CARGO_KEY,
+	SHM_DATA_PORT_OFFER_KEY,
+	SHM_DATA_DEMAND_KEY
+};
+
+static int section_get_id(shm_general_t *g, enum section_type section);
+static size_t section_get_size(shm_general_t *g, enum section_type section);
+static size_t section_get_size(shm_general_t *g, enum section_type section)
+{
+	switch (section) {
+	case SEC_PORTS:
+		return shm_port_get_segment_size(g);
+	case SEC_SHIPS:
+		return shm_ship_get_segment_size(g);
+	case SEC_CARGO:
+		return shm_cargo_get_segment_size(g);
+	case SEC_OFFER:
+		return shm_offer_get_segment_size(g);
+	case SEC_DEMAND:
+		return shm_demand_get_segment_size(g);
+	default:
+		return 0;
+	}
+}
+
+static void section_set_id(shm_general_t *g, enum section_type section, int id);
+static bool_t read_header(int fd, struct header *header);
+static void *map_slot(int fd, struct header *header, int slot, int prot, unsigned long *skip);
+static bool_t holds_complete(char *map, struct header *header);
+static void checkpoint_close(shm_general_t *g);
+static void write_lot(int quantity, int expire, bool_t last, void *arg);
+
+bool_t checkpoint_begin(shm_general_t *g, const char *path)
+{
+	char pending[CHECKPOINT_PATH_MAX];
+	struct header header;
+	unsigned long offset;
+	int fd, i;
+
+	if (strlen(path) + strlen(".tmp") >= CHECKPOINT_PATH_MAX) {
+		dprintf(2, "checkpoint.c: Path %s is too long.\n", path);
+		return FALSE;
+	}
+	sprintf(pending, "%s.tmp", path);
+
+	bzero(&header, sizeof(header));
+	strcpy(header.magic, CHECKPOINT_MAGIC);
+	header.version = CHECKPOINT_VERSION;
+	header.day = get_current_day(g) + 1;
+	header.n_ports = get_porti(g);
+	header.n_ships = get_navi(g);
+	header.n_cargo = get_merci(g);
+	header.lots_per_cargo = get_max_vita(g) + 1 + CHECKPOINT_SPARE_LOTS;
+	header.slot_size = ALIGN(sizeof(struct hold)
+				 + sizeof(struct lot) * header.n_cargo * header.lots_per_cargo);
+
+	offset = ALIGN(sizeof(header));
+	for (i = 0; i < SEC_HOLDS; i++) {
+		header.sections[i].offset = offset;
+		header.sections[i].size = shm_get_size(section_get_id(g, i));
+		offset += ALIGN(header.sections[i].size);
+	}
+	header.sections[SEC_HOLDS].offset = offset;
+	header.sections[SEC_HOLDS].size = header.slot_size * (header.n_ports + header.n_ships);
+	offset += header.sections[SEC_HOLDS].size;
+
+	fd = open(pending, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		dprintf(2, "checkpoint.c: Failed to create %s.\n", pending);
+		return FALSE;
+	}
+	/* Holds not saved yet read as zero, so they are never mistaken for complete ones */
+	if (ftruncate(fd, offset) == -1 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		dprintf(2, "checkpoint.c: Failed to write %s.\n", pending);
+		close(fd);
+		unlink(pending);
+		return FALSE;
+	}
+	close(fd);
+
+	set_checkpoint(g, pending, header.day);
+	sem_setval(sem_checkpoint_get_id(g), 0, 1);
+	return TRUE;
+}
+
+void checkpoint_join(shm_general_t *g, int slot, o_list_t **cargo_hold)
+{
+	sigset_t mask, old_mask;
+
+	/* Nothing may change the hold or wake the process until the snapshot is taken */
+	sigfillset(&mask);
+	sigprocmask(SIG_BLOCK, &mask, &old_mask);
+	if (checkpoint_save_hold(g, slot, cargo_hold) == FALSE)
+		dprintf(2, "checkpoint.c: Failed to save the hold of slot %d.\n", slot);
+	add_checkpoint_joined(g);
+	sem_execute_semop(sem_checkpoint_get_id(g), 0, 0, 0);
+	sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+bool_t checkpoint_end(shm_general_t *g)
+{
+	char path[CHECKPOINT_PATH_MAX];
+	struct header header;
+	struct stat info;
+	char *map;
+	void *segment;
+	bool_t res;
+	int fd, i;
+
+	fd = open(get_checkpoint_path(g), O_RDWR);
+	if (fd == -1 || read_header(fd, &header) == FALSE || fstat(fd, &info) == -1) {
+		dprintf(2, "checkpoint.c: Failed to open %s.\n", get_checkpoint_path(g));
+		if (fd != -1)
+			close(fd);
+		checkpoint_cancel(g);
+		return FALSE;
+	}
+	map = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		dprintf(2, "checkpoint.c: Failed to map %s.\n", get_checkpoint_path(g));
+		checkpoint_cancel(g);
+		return FALSE;
+	}
+
+	for (i = 0; i < SEC_HOLDS; i++) {
+		segment = shm_attach(section_get_id(g, i));
+		memcpy(map + header.sections[i].offset, segment, header.sections[i].size);
+		shm_detach(segment);
+	}
+	res = holds_complete(map, &header);
+	munmap(map, info.st_size);
+
+	/* A snapshot missing a hold is never committed, <path> keeps the previous one */
+	if (res == FALSE) {
+		dprintf(2, "checkpoint.c: A hold is missing from the snapshot of day %d.\n", header.day);
+		checkpoint_cancel(g);
+		return FALSE;
+	}
+	/* Strip ".tmp" */
+	strcpy(path, get_checkpoint_path(g));
+	path[strlen(path) - strlen(".tmp")] = '\0';
+	if (rename(get_checkpoint_path(g), path) == -1) {
+		dprintf(2, "checkpoint.c: Failed to commit %s.\n", path);
+		res = FALSE;
+	}
+	checkpoint_close(g);
+	return res;
+}
+
+void checkpoint_cancel(shm_general_t *g)
+{
+	if (get_checkpoint_day(g) < 0)
+		return;
+	unlink(get_checkpoint_path(g));
+	checkpoint_close(g);
+}
+
+bool_t checkpoint_save_hold(shm_general_t *g, int slot, o_list_t **cargo_hold)
+{
+	struct header header;
+	struct lot_writer writer;
+	struct hold *hold;
+	unsigned long skip;
+	char *map;
+	int fd, type;
+
+	fd = open(get_checkpoint_path(g), O_RDWR);
+	if (fd == -1) {
+		return FALSE;
+	}
+	if (read_header(fd, &header) == FALSE || header.day != get_checkpoint_day(g)) {
+		close(fd);
+		return FALSE;
+	}
+	map = map_slot(fd, &header, slot, PROT_READ | PROT_WRITE, &skip);
+	close(fd);
+	if (map == NULL) {
+		return FALSE;
+	}
+
+	hold = (struct hold *)(map + skip);
+	writer.max_lots = header.lots_per_cargo;
+	writer.overflow = FALSE;
+	for (type = 0; type < header.n_cargo && cargo_hold != NULL; type++) {
+		writer.lots = (struct lot *)(hold + 1) + type * header.lots_per_cargo;
+		writer.n_lots = 0;
+		cargo_list_for_each(cargo_hold[type], write_lot, &writer);
+		if (writer.n_lots < writer.max_lots)
+			writer.lots[writer.n_lots].quantity = 0;
+	}
+	/* The hold is left incomplete, so the snapshot is not committed */
+	if (writer.overflow) {
+		dprintf(2, "checkpoint.c: The hold of slot %d has more than %d lots of a type.\n",
+			slot, header.lots_per_cargo);
+		munmap(map, skip + header.slot_size);
+		return FALSE;
+	}
+	/* Marks the hold as complete */
+	hold->day = header.day;
+	munmap(map, skip + header.slot_size);
+	return TRUE;
+}
+
+shm_general_t *checkpoint_restore(const char *path, shm_general_t **g)
+{
+	struct header header;
+	struct stat info;
+	char *map;
+	void *segment;
+	int fd, i, id;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		dprintf(2, "checkpoint.c: Failed to open %s.\n", path);
+		return NULL;
+	}
+	if (read_header(fd, &header) == FALSE || fstat(fd, &info) == -1
+	    || (unsigned long)info.st_size < header.sections[SEC_HOLDS].offset + header.sections[SEC_HOLDS].size) {
+		dprintf(2, "checkpoint.c: %s is not a valid snapshot.\n", path);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	/* The processes refuse to start without their hold, see checkpoint_restore_hold() */
+	if (holds_complete(map, &header) == FALSE) {
+		dprintf(2, "checkpoint.c: %s misses the hold of a process.\n", path);
+		munmap(map, info.st_size);
+		return NULL;
+	}
+
+	*g = shm_general_restore(map + header.sections[SEC_GENERAL].offset,
+				 header.sections[SEC_GENERAL].size, header.day, path, g);
+	if (*g == NULL || get_porti(*g) != header.n_ports || get_navi(*g) != header.n_ships
+	    || get_merci(*g) != header.n_cargo) {
+		dprintf(2, "checkpoint.c: %s is inconsistent.\n", path);
+		munmap(map, info.st_size);
+		return NULL;
+	}
+
+	/* A snapshot of another layout is refused even if it has the same version */
+	for (i = SEC_GENERAL + 1; i < SEC_HOLDS; i++) {
+		if (header.sections[i].size != section_get_size(*g, i)) {
+			dprintf(2, "checkpoint.c: %s does not match the layout of the segments.\n", path);
+			munmap(map, info.st_size);
+			return NULL;
+		}
+	}
+	for (i = SEC_GENERAL + 1; i < SEC_HOLDS; i++) {
+		id = shm_create(ipc_key(section_keys[i]), header.sections[i].size);
+		if (id == -1) {
+			munmap(map, info.st_size);
+			return NULL;
+		}
+		segment = shm_attach(id);
+		memcpy(segment, map + header.sections[i].offset, header.sections[i].size);
+		shm_detach(segment);
+		section_set_id(*g, i, id);
+	}
+	munmap(map, info.st_size);
+
+	return *g;
+}
+
+bool_t checkpoint_restore_hold(shm_general_t *g, int slot, o_list_t **cargo_hold)
+{
+	struct header header;
+	struct hold *hold;
+	struct lot *lots;
+	unsigned long skip;
+	char *map;
+	int fd, type, i;
+
+	fd = open(get_restore_path(g), O_RDONLY);
+	if (fd == -1) {
+		return FALSE;
+	}
+	if (read_header(fd, &header) == FALSE) {
+		close(fd);
+		return FALSE;
+	}
+	map = map_slot(fd, &header, slot, PROT_READ, &skip);
+	close(fd);
+	if (map == NULL) {
+		return FALSE;
+	}
+
+	hold = (struct hold *)(map + skip);
+	if (hold->day != header.day) {
+		munmap(map, skip + header.slot_size);
+		return FALSE;
+	}
+	for (type = 0; type < header.n_cargo; type++) {
+		lots = (struct lot *)(hold + 1) + type * header.lots_per_cargo;
+		for (i = 0; i < header.lots_per_cargo && lots[i].quantity > 0; i++)
+			cargo_list_add(cargo_hold[type], lots[i].quantity, lots[i].expire);
+	}
+	munmap(map, skip + header.slot_size);
+	return TRUE;
+}
+
+int checkpoint_port_slot(int port_id) { return port_id; }
+int checkpoint_ship_slot(shm_general_t *g, int ship_id) { return get_porti(g) + ship_id; }
+
+static int section_get_id(shm_general_t *g, enum section_type section)
+{
+	switch (section) {
+	case SEC_GENERAL:
+		return shm_general_get_id(g);
+	case SEC_PORTS:
+		return shm_port_get_id(g);
+	case SEC_SHIPS:
+		return shm_ship_get_id(g);
+	case SEC_CARGO:
+		return shm_cargo_get_id(g);
+	case SEC_OFFER:
+		return shm_offer_get_id(g);
+	case SEC_DEMAND:
+		return shm_demand_get_id(g);
+	default:
+		return -1;
+	}
+}
+
+static void section_set_id(shm_general_t *g, enum section_type section, int id)
+{
+	switch (section) {
+	case SEC_PORTS:
+		shm_port_set_id(g, id);
+		break;
+	case SEC_SHIPS:
+		shm_ship_set_id(g, id);
+		break;
+	case SEC_CARGO:
+		shm_cargo_set_id(g, id);
+		break;
+	case SEC_OFFER:
+		shm_offer_set_id(g, id);
+		break;
+	case SEC_DEMAND:
+		shm_demand_set_id(g, id);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Tells whether every process saved its hold in a mapped snapshot.
+ */
+static bool_t holds_complete(char *map, struct header *header)
+{
+	struct hold *hold;
+	int slot;
+
+	for (slot = 0; slot < header->n_ports + header->n_ships; slot++) {
+		hold = (struct hold *)(map + header->sections[SEC_HOLDS].offset + header->slot_size * slot);
+		if (hold->day != header->day)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * @brief Forgets the pending snapshot and lets the processes that joined it go on.
+ */
+static void checkpoint_close(shm_general_t *g)
+{
+	set_checkpoint(g, "", -1);
+	set_checkpoint_phase(g, CHECKPOINT_IDLE);
+	sem_setval(sem_checkpoint_get_id(g), 0, 0);
+}
+
+static bool_t read_header(int fd, struct header *header)
+{
+	if (pread(fd, header, sizeof(*header), 0) != sizeof(*header))
+		return FALSE;
+	if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0
+	    || header->version != CHECKPOINT_VERSION)
+		return FALSE;
+	return TRUE;
+}
+
+/**
+ * @brief Maps the hold of a slot, mappings must start at a page boundary
+ * 	so skip is set to the offset of the hold in the returned mapping.
+ */
+static void *map_slot(int fd, struct header *header, int slot, int prot, unsigned long *skip)
+{
+	unsigned long offset, page_size;
+	void *map;
+
+	if (slot < 0 || slot >= header->n_ports + header->n_ships)
+		return NULL;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	offset = header->sections[SEC_HOLDS].offset + header->slot_size * slot;
+	*skip = offset % page_size;
+	map = mmap(NULL, *skip + header->slot_size, prot, MAP_SHARED, fd, offset - *skip);
+	return map == MAP_FAILED ? NULL : map;
+}
+
+static void write_lot(int quantity, int expire, bool_t last, void *arg)
+{
+	struct lot_writer *writer = arg;
+
+	(void)last;
+	/* Never happens unless lots are given an expiration past SO_MAX_VITA days */
+	if (writer->n_lots >= writer->max_lots) {
+		writer->overflow = TRUE;
+		return;
+	}
+	writer->lots[writer->n_lots].quantity = quantity;
+	writer->lots[writer->n_lots].expire = expire;
+	writer->n_lots++;
+}
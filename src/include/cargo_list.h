@@ -1,11 +1,23 @@
 #ifndef OS_PROJECT_CARGO_LIST_H
 #define OS_PROJECT_CARGO_LIST_H
 
+#include "types.h"
+
 /**
  * @brief Cargo list structure.
  */
 typedef struct o_list o_list_t;
 
+/**
+ * @brief Statistics of the per process pool that serves nodes and lists.
+ */
+struct cargo_list_pool_stats {
+	unsigned long slabs;		/* malloc calls made by the pool */
+	unsigned long allocations;	/* nodes and lists handed out */
+	unsigned long in_use;
+	unsigned long available;
+};
+
 /**
  * @brief Creates a new cargo list.
  * @return A pointer to the newly created cargo list.
@@ -21,13 +33,20 @@ o_list_t *cargo_list_create(void);
 void cargo_list_add(o_list_t *list, int quantity, int expire);
 
 /**
- * @brief Removes cargo items with a specific expire from the list.
+ * @brief Removes the cargo items that expired before a day from the list.
  * @param list The cargo list.
  * @param day The expiration date to check against.
  * @return The amount of removed cargo items.
  */
 int cargo_list_remove_expired(o_list_t *list, int day);
 
+/**
+ * @brief Gets the expiration date of the oldest lot of the list.
+ * @param list The cargo list.
+ * @return The expiration date or INT_MAX if the list is empty.
+ */
+int cargo_list_get_first_expire(o_list_t *list);
+
 /**
  * @brief Pops cargo items from the cargo list based on the needed quantity.
  *
@@ -40,7 +59,37 @@ int cargo_list_remove_expired(o_list_t *list, int day);
 o_list_t *cargo_list_pop_needed(o_list_t *list, int quantity);
 
 /**
- * @brief Deletes the list and frees up memory.
+ * @brief Function called by cargo_list_consume() for every consumed lot.
+ * @param quantity Quantity taken from the lot.
+ * @param expire Expiration date of the lot.
+ * @param last TRUE if no other lot will be visited.
+ * @param arg Argument passed to cargo_list_consume().
+ */
+typedef void (*cargo_list_visitor_t)(int quantity, int expire, bool_t last, void *arg);
+
+/**
+ * @brief Consumes in place the oldest lots of the list until quantity is reached.
+ *
+ * 	Every lot is touched once and handed to the visitor, nothing is allocated.
+ *
+ * @param list The cargo list.
+ * @param quantity The needed quantity.
+ * @param visitor Function called for every consumed lot, can be NULL.
+ * @param arg Argument passed to the visitor.
+ * @return the consumed quantity, lower than quantity if the list ran out of lots.
+ */
+int cargo_list_consume(o_list_t *list, int quantity, cargo_list_visitor_t visitor, void *arg);
+
+/**
+ * @brief Visits every lot of the list from the oldest, without modifying it.
+ * @param list The cargo list.
+ * @param visitor Function called for every lot.
+ * @param arg Argument passed to the visitor.
+ */
+void cargo_list_for_each(o_list_t *list, cargo_list_visitor_t visitor, void *arg);
+
+/**
+ * @brief Deletes the list and gives all its nodes back to the pool at once.
  * @param list The cargo list to be deleted.
  */
 void cargo_list_delete(o_list_t *list);
@@ -75,4 +124,23 @@ int cargo_list_get_not_expired_by_day(o_list_t *list, int expire_day);
  */
 int cargo_list_get_quantity(o_list_t *list);
 
+/**
+ * @brief Gets the statistics of the pool of the calling process.
+ * @param stats Pointer where the statistics are stored.
+ */
+void cargo_list_pool_get_stats(struct cargo_list_pool_stats *stats);
+
+/**
+ * @brief Makes the pool safe to use from several threads of the process.
+ * @param lock Called before the pool is used, NULL if the process has a single thread.
+ * @param unlock Called after the pool is used.
+ */
+void cargo_list_pool_set_lock(void (*lock)(void), void (*unlock)(void));
+
+/**
+ * @brief Frees all the memory held by the pool.
+ * 	Every list must have been deleted before.
+ */
+void cargo_list_pool_destroy(void);
+
 #endif
@@ -0,0 +1,88 @@
+#ifndef OS_PROJECT_CHECKPOINT_H
+#define OS_PROJECT_CHECKPOINT_H
+
+#include "shm_general.h"
+#include "cargo_list.h"
+#include "types.h"
+
+/**
+ * @brief Snapshots of the simulation taken at day boundaries.
+ *
+ * 	A snapshot is a single versioned file made of a header and of
+ * 	sections aligned so that they can be mapped and copied as they are:
+ * 	one for every shared memory segment and one slot per process for its
+ * 	cargo hold. A snapshot is taken at a barrier on the day tick: the
+ * 	master creates "<path>.tmp", every ship and then every port saves its
+ * 	own slot and waits, the master copies the shared segments while no
+ * 	process runs and renames the file to <path> only if every slot was
+ * 	saved, so <path> always holds a complete and consistent snapshot.
+ */
+
+/**
+ * @brief Creates a pending snapshot and closes the gate that the processes
+ * 	joining it wait on.
+ * @param g Pointer to the general shared memory structure.
+ * @param path Path of the snapshot.
+ * @return TRUE on success, FALSE otherwise.
+ */
+bool_t checkpoint_begin(shm_general_t *g, const char *path);
+
+/**
+ * @brief Saves the cargo hold of the calling process in the pending snapshot,
+ * 	then waits with every signal blocked until the snapshot is taken.
+ * @param g Pointer to the general shared memory structure.
+ * @param slot The slot of the process, from checkpoint_port_slot() or checkpoint_ship_slot().
+ * @param cargo_hold Array of get_merci() cargo lists.
+ */
+void checkpoint_join(shm_general_t *g, int slot, o_list_t **cargo_hold);
+
+/**
+ * @brief Copies the shared segments in the pending snapshot once every
+ * 	process joined it, renames it to its final path if every slot was
+ * 	saved and opens the gate.
+ * @param g Pointer to the general shared memory structure.
+ * @return TRUE if the snapshot was committed, FALSE otherwise.
+ */
+bool_t checkpoint_end(shm_general_t *g);
+
+/**
+ * @brief Removes the pending snapshot, if any, and opens the gate.
+ * @param g Pointer to the general shared memory structure.
+ */
+void checkpoint_cancel(shm_general_t *g);
+
+/**
+ * @brief Saves a cargo hold in the pending snapshot.
+ * @param g Pointer to the general shared memory structure.
+ * @param slot The slot of the process, from checkpoint_port_slot() or checkpoint_ship_slot().
+ * @param cargo_hold Array of get_merci() cargo lists, NULL for an empty hold.
+ * @return TRUE on success, FALSE otherwise.
+ */
+bool_t checkpoint_save_hold(shm_general_t *g, int slot, o_list_t **cargo_hold);
+
+/**
+ * @brief Recreates every shared segment from a snapshot.
+ *
+ * 	Semaphores and message queues are not part of the snapshot and must be
+ * 	initialized by the caller.
+ *
+ * @param path Path of the snapshot.
+ * @param g Pointer to the pointer of the general shared memory structure.
+ * @return Pointer to the restored general shared memory structure or NULL on failure.
+ */
+shm_general_t *checkpoint_restore(const char *path, shm_general_t **g);
+
+/**
+ * @brief Fills the cargo hold of the calling process from the snapshot it was restored from.
+ * @param g Pointer to the general shared memory structure.
+ * @param slot The slot of the process.
+ * @param cargo_hold Array of get_merci() empty cargo lists.
+ * @return TRUE if the slot was saved in the snapshot, FALSE otherwise.
+ */
+bool_t checkpoint_restore_hold(shm_general_t *g, int slot, o_list_t **cargo_hold);
+
+/* Slots */
+int checkpoint_port_slot(int port_id);
+int checkpoint_ship_slot(shm_general_t *g, int ship_id);
+
+#endif
@@ -1,26 +1,49 @@
 #ifndef OS_PROJECT_CONST_H
 #define OS_PROJECT_CONST_H
 
+/*
+ * Base keys of the IPC objects, the actual keys are derived with ipc_key()
+ * from the namespace of the simulation: the bits in IPC_NS_MASK must be
+ * all set and the other bits must be unique.
+ */
+#define IPC_NS_MASK 0xfffff
+
 #define SHM_DATA_GENERAL_KEY 0x1fffffff
 #define SHM_DATA_PORTS_KEY 0x2fffffff
 #define SHM_DATA_SHIPS_KEY 0x3fffffff
 #define SHM_DATA_CARGO_KEY 0x4fffffff
 #define SHM_DATA_PORT_OFFER_KEY 0x5fffffff
 #define SHM_DATA_DEMAND_KEY 0x6fffffff
+#define SHM_DATA_STATS_KEY 0x7fffffff
 
 #define SEM_PORTS_INITIALIZED_KEY 0x00ffffff
 #define SEM_START_KEY 0x10ffffff
 #define SEM_DOCK_KEY 0x11ffffff
 #define SEM_CARGO_KEY 0x12ffffff
+#define SEM_EPOCH_KEY 0x13ffffff
+#define SEM_RESERVATION_KEY 0x14ffffff
+#define SEM_CHECKPOINT_KEY 0x15ffffff
+#define SEM_NAMESPACE_KEY 0x16ffffff	/* claim of the namespace, see ipc_claim_namespace() */
 
 #define MSG_IN_PORT_KEY 0x100fffff
 #define MSG_OUT_PORT_KEY 0x110fffff
 
+/* The queues of a region use the bits above IPC_NS_MASK left free by the base keys */
+#define SHARD_MAX 16
+#define SHARD_KEY(key, shard) ((key) + ((shard) << 20))
+
 #define SIGDAY SIGUSR1
 #define SIGSWELL SIGUSR2
 #define SIGSTORM SIGUSR2
 #define SIGMAELSTROM SIGTERM
 
-#define NUM_CONST 16
+#define NUM_CONST 21
+#define NUM_REQUIRED_CONST 16	/* the others are optional, see shm_general.c */
+
+#define CHECKPOINT_PATH_MAX 256
+#define PORTI_MAX 32000	/* SEMMSL, some semaphore sets have one semaphore per port */
+
+#define RESERVATION_TTL 2	/* days a demand reservation outlives the expected arrival */
+#define PIPELINE_MAX 8	/* requests a ship keeps in flight, see sell_all() */
 
 #endif
@@ -15,6 +15,13 @@ enum status {
 	STATUS_BUY
 };
 
+#define MSG_LOTS 8	/* lots carried by a single reply to a buy request */
+
+struct commerce_lot {
+	int quantity;
+	int expiry_date;
+};
+
 struct commerce_msg {
 	long receiver;
 	long sender;
@@ -23,18 +30,24 @@ struct commerce_msg {
 	int expiry_date;
 
 	int status;
+
+	/* Lots of a reply to a buy request, only the first n_lots are sent */
+	int n_lots;
+	struct commerce_lot lots[MSG_LOTS];
 };
 
 /**
  * @brief Initialize an incoming message queue.
+ * @param shard The region served by the queue.
  * @return The identifier of the initialized message queue.
  */
-int msg_commerce_in_port_init(void);
+int msg_commerce_in_port_init(int shard);
 /**
  * @brief Initialize an outgoing message queue.
+ * @param shard The region served by the queue.
  * @return The identifier of the initialized message queue.
  */
-int msg_commerce_out_port_init(void);
+int msg_commerce_out_port_init(int shard);
 
 /**
  * @brief Create a commerce message.
@@ -57,6 +70,25 @@ struct commerce_msg msg_commerce_create(long receiver_id, long sender_id,
  */
 void msg_commerce_send(int queue_id, struct commerce_msg *msg);
 
+/**
+ * @brief Adds a lot to a reply to a buy request.
+ * @param msg Pointer to the reply, created with msg_commerce_create().
+ * @param quantity Quantity of the lot.
+ * @param expiry_date Expiry date of the lot.
+ * @return TRUE if the reply is full and must be sent.
+ */
+bool_t msg_commerce_add_lot(struct commerce_msg *msg, int quantity, int expiry_date);
+
+/**
+ * @brief Receive a whole commerce message, lots included, from a message queue.
+ * @param queue_id Identifier of the message queue.
+ * @param type Type of the message to receive.
+ * @param msg Pointer to store the message.
+ * @param wait Whether to wait for a message, FALSE returns at once if there is none.
+ * @return TRUE if a message was received, FALSE if there was none or the call was interrupted.
+ */
+bool_t msg_commerce_receive_msg(int queue_id, int type, struct commerce_msg *msg, bool_t wait);
+
 /**
  * @brief Receive a commerce message from a message queue.
  * @param queue_id Identifier of the message queue.
@@ -0,0 +1,75 @@
+#ifndef OS_PROJECT_ROUTE_H
+#define OS_PROJECT_ROUTE_H
+
+#include "shm_general.h"
+#include "shm_port.h"
+#include "shm_cargo.h"
+#include "shm_offer_demand.h"
+#include "cargo_list.h"
+#include "types.h"
+
+/**
+ * @brief Calculates the time needed to sail between two points.
+ * @param g Pointer to the general shared memory structure.
+ * @param from Starting coordinates.
+ * @param to Destination coordinates.
+ * @return The travel time in days.
+ */
+double route_get_travel_time(shm_general_t *g, struct coord from, struct coord to);
+
+/**
+ * @brief Gets the region of a point, the map is split in SO_SHARDS x SO_SHARDS
+ * 	squares numbered by row from the origin.
+ * @param g Pointer to the general shared memory structure.
+ * @param position The point.
+ * @return The region, 0 unless SO_SHARDS is set.
+ */
+int route_get_shard(shm_general_t *g, struct coord position);
+
+/**
+ * @brief Finds the port where a ship can sell the biggest amount of its cargo.
+ *
+ * 	Cargo expiring before the arrival is not counted, ties are broken on travel time.
+ * 	The arrival includes the expected wait for a dock, see shm_port_get_expected_wait().
+ *
+ * @param g Pointer to the general shared memory structure.
+ * @param p Pointer to the array of ports.
+ * @param d Pointer to the demands.
+ * @param cargo_hold Array of cargo lists of the ship.
+ * @param position Current position of the ship.
+ * @param curr_port_id Port where the ship is docked, it's never picked.
+ * @return the id of the best port.
+ */
+int route_find_best_port(shm_general_t *g, shm_port_t *p, shm_demand_t *d,
+			 o_list_t **cargo_hold, struct coord position, int curr_port_id);
+
+/**
+ * @brief Picks the next port looking two hops ahead.
+ *
+ * 	The first hops that sell the most are expanded with a beam search: at
+ * 	each of them the ship sells, buys what the offer and its freed capacity
+ * 	allow and sails to the port where what it carries sells the most.
+ * 	The second hop is explored only within a fixed budget of evaluations
+ * 	per call, and the result is cached per port, day and content of the
+ * 	hold, so the cost of a call is bounded.
+ *
+ * @param g Pointer to the general shared memory structure.
+ * @param p Pointer to the array of ports.
+ * @param o Pointer to the offers.
+ * @param d Pointer to the demands.
+ * @param c Pointer to the cargo types.
+ * @param cargo_hold Array of cargo lists of the ship.
+ * @param free_tons Free capacity of the ship.
+ * @param position Current position of the ship.
+ * @param curr_port_id Port where the ship is docked, it's never picked.
+ * @return the id of the first port of the best route.
+ */
+int route_plan(shm_general_t *g, shm_port_t *p, shm_offer_t *o, shm_demand_t *d, shm_cargo_t *c,
+	       o_list_t **cargo_hold, int free_tons, struct coord position, int curr_port_id);
+
+/**
+ * @brief Frees the scratch memory of route_plan().
+ */
+void route_plan_destroy(void);
+
+#endif
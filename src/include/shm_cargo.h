@@ -21,6 +21,14 @@ typedef struct shm_cargo shm_cargo_t;
  */
 shm_cargo_t *shm_cargo_initialize(shm_general_t *g);
 
+/**
+ * @brief Gets the size of the shared memory segment for cargo.
+ *
+ * @param g Pointer to shared memory general information.
+ * @return The size in bytes.
+ */
+size_t shm_cargo_get_segment_size(shm_general_t *g);
+
 /**
  * @brief Attaches to the existing shared memory for cargo.
  *
@@ -168,6 +176,28 @@ void shm_cargo_update_dump_expired_on_ship(shm_cargo_t *c, int id, int quantity,
  */
 void shm_cargo_update_dump_received_in_port(shm_cargo_t *c, int id, int quantity, int sem_cargo_id);
 
+/**
+ * @brief Adds generated cargo to both the total generated and the available in
+ * 	port quantities of a cargo type, taking its semaphore once.
+ *
+ * @param c Pointer to shared memory for cargo.
+ * @param id Cargo type ID.
+ * @param quantity Quantity to add.
+ * @param sem_cargo_id Semaphore ID for the cargo type.
+ */
+void shm_cargo_update_dump_generated(shm_cargo_t *c, int id, int quantity, int sem_cargo_id);
+
+/**
+ * @brief Updates the dumps of a cargo type for the trades of a port with a single lock.
+ *
+ * @param c Pointer to shared memory for cargo.
+ * @param id Cargo type ID.
+ * @param received Quantity bought by the port from the ships.
+ * @param shipped Quantity sold by the port to the ships.
+ * @param sem_cargo_id Semaphore ID for the cargo type.
+ */
+void shm_cargo_update_dump_port_trade(shm_cargo_t *c, int id, int received, int shipped, int sem_cargo_id);
+
 /**
  * @brief Sets the quantity of available cargo in the port for a specific cargo type.
  *
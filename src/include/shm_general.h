@@ -1,6 +1,10 @@
 #ifndef OS_PROJECT_SHM_GENERAL_H
 #define OS_PROJECT_SHM_GENERAL_H
 
+#include <stddef.h>
+
+#include "types.h"
+
 /**
  * @brief Structure for storing general simulation parameters and shared memory identifiers.
  */
@@ -8,17 +12,68 @@ typedef struct shm_general shm_general_t;
 
 /**
  * @brief Reads configuration values from a file and updates the shared memory structure.
+ *
+ * 	Every line is either "SO_NAVI=1000", in any order, or a bare value
+ * 	taken in the positional order of the constants; '#' starts a comment.
+ * 	Every constant must be set once and be in range.
+ *
  * @param path Path to the configuration file.
  * @param g Pointer to the pointer of the general shared memory structure.
  * @return Pointer to the updated general shared memory structure or NULL on failure.
  */
 shm_general_t *read_from_path(char *path, shm_general_t **g);
 
+/**
+ * @brief Gets the position of a constant in the configuration file.
+ * @param name Name of the constant, like "SO_NAVI".
+ * @return The index of the constant or -1 if it does not exist.
+ */
+int get_constant_index(const char *name);
+
+/**
+ * @brief Overrides the value of a constant read from the configuration file.
+ * @param g Pointer to the general shared memory structure.
+ * @param index Index of the constant, from get_constant_index().
+ * @param value The new value.
+ */
+void set_constant(shm_general_t *g, int index, double value);
+
+/**
+ * @brief Checks the ranges of the constants and computes the derived ones,
+ * 	must be called again after set_constant().
+ * @param g Pointer to the general shared memory structure.
+ * @return TRUE if the constants are valid, FALSE otherwise.
+ */
+bool_t validate_constants(shm_general_t *g);
+
+/**
+ * @brief Recreates the general shared memory structure from a snapshot.
+ *
+ * 	Only the shm ids must be fixed by the caller, sem and msg ids
+ * 	are recreated by shm_general_ipc_init().
+ *
+ * @param data The snapshot of the structure.
+ * @param size Size of the snapshot.
+ * @param day The day the simulation restarts from.
+ * @param path Path of the snapshot file, read by the children to restore their holds.
+ * @param g Pointer to the pointer of the general shared memory structure.
+ * @return Pointer to the restored general shared memory structure or NULL on failure.
+ */
+shm_general_t *shm_general_restore(const void *data, size_t size, int day, const char *path, shm_general_t **g);
+
 /**
  * @brief Initializes ipc related to general shm.
  * @param g pointer to general shm struct.
+ * @return TRUE on success, FALSE if an object could not be created, in
+ * 	which case the ones created are deleted.
+ */
+bool_t shm_general_ipc_init(shm_general_t *g);
+
+/**
+ * @brief Deletes the semaphores and queues created by shm_general_ipc_init().
+ * @param g pointer to general shm struct.
  */
-void shm_general_ipc_init(shm_general_t *g);
+void shm_general_ipc_delete(shm_general_t *g);
 
 /**
  * @brief Attaches the process to the shared memory segment for the general structure.
@@ -75,6 +130,13 @@ void shm_offer_set_id(shm_general_t *g, int id);
  */
 void shm_demand_set_id(shm_general_t *g, int id);
 
+/**
+ * @brief Sets the shared memory ID for the statistics structure.
+ * @param g  Pointer to the shm_general_t structure.
+ * @param id The shared memory ID to be set for statistics.
+ */
+void shm_stats_set_id(shm_general_t *g, int id);
+
 /* SHM id getters */
 
 /**
@@ -119,6 +181,13 @@ int shm_offer_get_id(shm_general_t *g);
  */
 int shm_demand_get_id(shm_general_t *g);
 
+/**
+ * @brief Gets the shared memory ID for the statistics structure.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The shared memory ID for the statistics structure.
+ */
+int shm_stats_get_id(shm_general_t *g);
+
 /* Semaphores id getters */
 
 /**
@@ -142,22 +211,47 @@ int sem_port_init_get_id(shm_general_t *g);
  */
 int sem_cargo_get_id(shm_general_t *g);
 
+/**
+ * @brief Gets the semaphore ID for the day barrier, one semaphore per port:
+ * 	its value is the number of days that the port has still to process.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The semaphore ID for the day barrier.
+ */
+int sem_epoch_get_id(shm_general_t *g);
+
+/**
+ * @brief Gets the semaphore ID for the locks of the demand reservations, one per port.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The semaphore ID for the reservation locks.
+ */
+int sem_reservation_get_id(shm_general_t *g);
+
+/**
+ * @brief Gets the semaphore ID for the gate of the snapshots: it is
+ * 	nonzero while the processes that joined a snapshot must wait.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The semaphore ID for the snapshot gate.
+ */
+int sem_checkpoint_get_id(shm_general_t *g);
+
 /* Message queues id getters */
 
 /**
  * @brief Gets the message queue ID for incoming messages.
  * @param g Pointer to the shm_general_t structure.
+ * @param shard The region of the port, 0 unless SO_SHARDS is set.
  * @return The message queue ID for incoming messages.
  */
-int msg_in_get_id(shm_general_t *g);
+int msg_in_get_id(shm_general_t *g, int shard);
 
 /**
  * @brief Gets the message queue ID for outgoing messages.
  *
  * @param g Pointer to the shm_general_t structure.
+ * @param shard The region of the port, 0 unless SO_SHARDS is set.
  * @return The message queue ID for outgoing messages.
  */
-int msg_out_get_id(shm_general_t *g);
+int msg_out_get_id(shm_general_t *g, int shard);
 
 /* Day getter and setter */
 
@@ -169,7 +263,92 @@ int msg_out_get_id(shm_general_t *g);
 int get_current_day(shm_general_t *g);
 
 /**
- * @brief Increases the current day counter in the shared memory structure.
+ * @brief Gets the time at which the current day started.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The monotonic time of the last day tick in nanoseconds.
+ */
+unsigned long get_day_tick_ns(shm_general_t *g);
+
+/* Checkpoint getters and setters */
+
+/**
+ * @brief Processes that join a pending checkpoint: the ships first, then
+ * 	the ports once no ship can send them requests.
+ */
+enum checkpoint_phase {
+	CHECKPOINT_IDLE,
+	CHECKPOINT_SHIPS,
+	CHECKPOINT_PORTS
+};
+
+/**
+ * @brief Gets the day at which the processes save their holds in the pending checkpoint.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The day of the pending checkpoint, -1 if none was requested.
+ */
+int get_checkpoint_day(shm_general_t *g);
+
+/**
+ * @brief Gets the path of the pending checkpoint file.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The path of the pending checkpoint.
+ */
+const char *get_checkpoint_path(shm_general_t *g);
+
+/**
+ * @brief Gets the day the simulation was restored at.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The restored day, -1 if the simulation started from scratch.
+ */
+int get_restore_day(shm_general_t *g);
+
+/**
+ * @brief Gets the path of the snapshot the simulation was restored from.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The path of the snapshot.
+ */
+const char *get_restore_path(shm_general_t *g);
+
+/**
+ * @brief Gets the processes that have to join the pending checkpoint.
+ * @param g Pointer to the shm_general_t structure.
+ * @return One of enum checkpoint_phase.
+ */
+int get_checkpoint_phase(shm_general_t *g);
+
+/**
+ * @brief Sets the processes that have to join the pending checkpoint
+ * 	and resets the number of processes that joined it.
+ * @param g Pointer to the shm_general_t structure.
+ * @param phase One of enum checkpoint_phase.
+ */
+void set_checkpoint_phase(shm_general_t *g, int phase);
+
+/**
+ * @brief Gets the number of processes that joined the current phase of the checkpoint.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The number of processes.
+ */
+int get_checkpoint_joined(shm_general_t *g);
+
+/**
+ * @brief Counts the calling process as joined to the current phase of the checkpoint.
+ * @param g Pointer to the shm_general_t structure.
+ */
+void add_checkpoint_joined(shm_general_t *g);
+
+/**
+ * @brief Requests the processes to save their holds in a pending checkpoint.
+ * @param g Pointer to the shm_general_t structure.
+ * @param path Path of the pending checkpoint file, shorter than CHECKPOINT_PATH_MAX.
+ * @param day The day at which the holds are saved.
+ */
+void set_checkpoint(shm_general_t *g, const char *path, int day);
+
+/**
+ * @brief Increases the current day counter in the shared memory structure
+ * 	and stores the time of the day tick. The new day is added to the
+ * 	day barrier of every port first.
  * @param c Pointer to the general shared memory structure.
  */
 void increase_day(shm_general_t *g);
@@ -192,5 +371,106 @@ int get_max_vita(shm_general_t *g);
 int get_storm_duration(shm_general_t *g);
 int get_swell_duration(shm_general_t *g);
 int get_maelstrom(shm_general_t *g);
+int get_day_lag(shm_general_t *g);
+int get_dock_workers(shm_general_t *g);
+int get_pipeline(shm_general_t *g);
+int get_sparse_max(shm_general_t *g);
+int get_shards(shm_general_t *g);
+
+/* Getters for derived constants. */
+
+/**
+ * @brief Gets the tons of cargo generated every day, SO_FILL / SO_DAYS.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The daily fill.
+ */
+int get_daily_fill(shm_general_t *g);
+
+/**
+ * @brief Gets the number of cargo types every port trades, SO_SPARSE_MAX if
+ * 	it is set and lower than SO_MERCI, SO_MERCI otherwise.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The number of cargo types of a port.
+ */
+int get_port_types(shm_general_t *g);
+
+/**
+ * @brief Gets the number of regions of the map, SO_SHARDS * SO_SHARDS if
+ * 	it is set, 1 otherwise.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The number of regions.
+ */
+int get_regions(shm_general_t *g);
+
+/**
+ * @brief Gets 1 / SO_SPEED, to turn distances into days.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The inverse of the speed.
+ */
+double get_inv_speed(shm_general_t *g);
+
+/**
+ * @brief Gets the cargo type with the smallest batch size.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The cargo type.
+ */
+int get_size_min_id(shm_general_t *g);
+
+/**
+ * @brief Gets the smallest batch size among the cargo types.
+ * @param g Pointer to the shm_general_t structure.
+ * @return The batch size.
+ */
+int get_size_min(shm_general_t *g);
+
+/**
+ * @brief Stores the cargo type with the smallest batch size.
+ * @param g Pointer to the shm_general_t structure.
+ * @param id The cargo type.
+ * @param size Its batch size.
+ */
+void set_size_min(shm_general_t *g, int id, int size);
+
+/**
+ * @brief Checks that the constants match the ones of a specialized build.
+ * @param g Pointer to the shm_general_t structure.
+ * @return TRUE if they match or if the build is not specialized.
+ */
+bool_t check_constants(shm_general_t *g);
+
+/*
+ * A specialized build (make specialized SCENARIO=...) bakes the constants
+ * of a configuration file in, so the getters become compile time values.
+ */
+#ifdef SO_SCENARIO
+#include "scenario.h"
+
+#define get_lato(g) ((double)SO_LATO_VALUE)
+#define get_days(g) ((int)SO_DAYS_VALUE)
+#define get_navi(g) ((int)SO_NAVI_VALUE)
+#define get_speed(g) ((int)SO_SPEED_VALUE)
+#define get_capacity(g) ((int)SO_CAPACITY_VALUE)
+#define get_porti(g) ((int)SO_PORTI_VALUE)
+#define get_banchine(g) ((int)SO_BANCHINE_VALUE)
+#define get_fill(g) ((int)SO_FILL_VALUE)
+#define get_load_speed(g) ((int)SO_LOADSPEED_VALUE)
+#define get_merci(g) ((int)SO_MERCI_VALUE)
+#define get_size(g) ((int)SO_SIZE_VALUE)
+#define get_min_vita(g) ((int)SO_MIN_VITA_VALUE)
+#define get_max_vita(g) ((int)SO_MAX_VITA_VALUE)
+#define get_storm_duration(g) ((int)SO_STORM_DURATION_VALUE)
+#define get_swell_duration(g) ((int)SO_SWELL_DURATION_VALUE)
+#define get_maelstrom(g) ((int)SO_MAELSTROM_VALUE)
+#define get_day_lag(g) ((int)SO_DAY_LAG_VALUE)
+#define get_dock_workers(g) ((int)SO_DOCK_WORKERS_VALUE)
+#define get_pipeline(g) ((int)SO_PIPELINE_VALUE)
+#define get_sparse_max(g) ((int)SO_SPARSE_MAX_VALUE)
+#define get_shards(g) ((int)SO_SHARDS_VALUE)
+#define get_daily_fill(g) ((int)SO_FILL_VALUE / (int)SO_DAYS_VALUE)
+#define get_port_types(g) ((int)SO_SPARSE_MAX_VALUE > 0 && (int)SO_SPARSE_MAX_VALUE < (int)SO_MERCI_VALUE \
+			   ? (int)SO_SPARSE_MAX_VALUE : (int)SO_MERCI_VALUE)
+#define get_regions(g) ((int)SO_SHARDS_VALUE > 0 ? (int)SO_SHARDS_VALUE * (int)SO_SHARDS_VALUE : 1)
+#define get_inv_speed(g) (1.0 / SO_SPEED_VALUE)
+#endif
 
 #endif
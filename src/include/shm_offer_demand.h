@@ -1,6 +1,7 @@
 #ifndef OS_PROJECT_OFFER_H
 #define OS_PROJECT_OFFER_H
 
+#include <limits.h>
 #include <stdlib.h>
 
 #include "shm_general.h"
@@ -18,13 +19,47 @@ typedef struct shm_offer shm_offer_t;
  */
 typedef struct shm_demand shm_demand_t;
 
+/*
+ * Offer and demand are stored by port in rows of entries, one per cargo type
+ * the port trades. The rows hold every type unless SO_SPARSE_MAX is lower
+ * than SO_MERCI: then every port trades SO_SPARSE_MAX types picked at start,
+ * and the loops over a port visit the row instead of every type:
+ *
+ * 	for (i = 0; i < get_port_types(g); i++)
+ * 		type = shm_offer_get_row_type(g, o, port_id, i);
+ *
+ * For every cargo type the segments also keep the set of ports with a nonzero
+ * offer (or demand) of it, one bit per port in shm_offer_demand_get_set_words()
+ * words, so the candidates of a search are the OR of a few sets.
+ */
+
+/**
+ * @brief Number of ports in a word of a port set.
+ */
+#define PORT_SET_BITS ((int)(sizeof(unsigned long) * CHAR_BIT))
+
+/**
+ * @brief Gets the number of words of a port set.
+ * @param g Pointer to shared memory general information.
+ * @return The number of words, enough for SO_PORTI bits.
+ */
+int shm_offer_demand_get_set_words(shm_general_t *g);
+
 /**
- * @brief Initializes and attaches shared memory for offer data associated with ports.
+ * @brief Initializes and attaches shared memory for offer data associated with ports,
+ * 	picking the cargo types of every port.
  * @param g pointer to general SHM
  * @return Pointer to the attached offer data structure or NULL on failure.
  */
 shm_offer_t *shm_offer_init(shm_general_t *g);
 
+/**
+ * @brief Gets the size of the shared memory segment for offer data.
+ * @param g pointer to general SHM
+ * @return The size in bytes.
+ */
+size_t shm_offer_get_segment_size(shm_general_t *g);
+
 /**
  * @brief Attaches shared memory for offer data in ports.
  * @param g pointer to general shm
@@ -69,12 +104,49 @@ int shm_offer_get_quantity(shm_general_t *g, shm_offer_t *o, int port_id, int ca
  */
 int shm_offer_get_tot_quantity(shm_general_t *g, shm_offer_t *o, int port_id);
 
+/**
+ * @brief Gets the set of the ports with a nonzero offer of a cargo type.
+ * @param g Pointer to shared memory general information.
+ * @param o Pointer to shared memory for offers.
+ * @param cargo_id Cargo ID.
+ * @return The port set, read without locks so it is only a hint.
+ */
+const unsigned long *shm_offer_get_port_set(shm_general_t *g, shm_offer_t *o, int cargo_id);
+
+/**
+ * @brief Gets the cargo type of an entry of the row of a port.
+ * @param g Pointer to shared memory general information.
+ * @param o Pointer to shared memory for offers.
+ * @param port_id Port ID.
+ * @param i Entry, lower than get_port_types().
+ * @return The cargo type.
+ */
+int shm_offer_get_row_type(shm_general_t *g, shm_offer_t *o, int port_id, int i);
+
+/**
+ * @brief Gets the quantity offered by an entry of the row of a port.
+ * @param g Pointer to shared memory general information.
+ * @param o Pointer to shared memory for offers.
+ * @param port_id Port ID.
+ * @param i Entry, lower than get_port_types().
+ * @return The quantity offered.
+ */
+int shm_offer_get_row_quantity(shm_general_t *g, shm_offer_t *o, int port_id, int i);
+
 /**
  * @brief Initializes and attaches shared memory for demand data associated with ports.
  * @param g Pointer to general SHM
+ * @param o Pointer to shared memory for offers, whose cargo types are copied.
  * @return Pointer to the attached demand data structure or NULL on failure.
  */
-shm_demand_t *shm_demand_init(shm_general_t *g);
+shm_demand_t *shm_demand_init(shm_general_t *g, shm_offer_t *o);
+
+/**
+ * @brief Gets the size of the shared memory segment for demand data.
+ * @param g Pointer to general SHM
+ * @return The size in bytes.
+ */
+size_t shm_demand_get_segment_size(shm_general_t *g);
 
 /**
  * @brief Attaches shared memory for demand data in ports.
@@ -111,6 +183,91 @@ int shm_demand_get_quantity(shm_general_t *g, shm_demand_t *d, int port_id, int
 void shm_demand_remove_quantity(shm_demand_t *d, shm_general_t *g, int id, int type,
 		       int quantity);
 
+/* Reservations */
+
+/**
+ * @brief Gets the demand of a cargo type at a port that is not reserved by
+ * 	the ships travelling to it.
+ * @param g Pointer to shared memory general information.
+ * @param d Pointer to shared memory for demand.
+ * @param port_id Port ID.
+ * @param cargo_id Cargo ID.
+ * @return The demand left to the ships without a reservation, never negative.
+ */
+int shm_demand_get_available(shm_general_t *g, shm_demand_t *d, int port_id, int cargo_id);
+
+/**
+ * @brief Gets the set of the ports with a nonzero demand of a cargo type,
+ * 	reserved or not.
+ * @param g Pointer to shared memory general information.
+ * @param d Pointer to shared memory for demand.
+ * @param cargo_id Cargo ID.
+ * @return The port set, read without locks so it is only a hint.
+ */
+const unsigned long *shm_demand_get_port_set(shm_general_t *g, shm_demand_t *d, int cargo_id);
+
+/**
+ * @brief Gets the cargo type of an entry of the row of a port.
+ * @param g Pointer to shared memory general information.
+ * @param d Pointer to shared memory for demand.
+ * @param port_id Port ID.
+ * @param i Entry, lower than get_port_types().
+ * @return The cargo type.
+ */
+int shm_demand_get_row_type(shm_general_t *g, shm_demand_t *d, int port_id, int i);
+
+/**
+ * @brief Like shm_demand_get_available() for an entry of the row of a port.
+ * @param g Pointer to shared memory general information.
+ * @param d Pointer to shared memory for demand.
+ * @param port_id Port ID.
+ * @param i Entry, lower than get_port_types().
+ * @return The demand left to the ships without a reservation, never negative.
+ */
+int shm_demand_get_row_available(shm_general_t *g, shm_demand_t *d, int port_id, int i);
+
+/**
+ * @brief Gets the quantity of a cargo type that a ship reserved at a port.
+ * @param g Pointer to shared memory general information.
+ * @param d Pointer to shared memory for demand.
+ * @param ship_id Ship ID.
+ * @param port_id Port ID.
+ * @param cargo_id Cargo ID.
+ * @return The reserved quantity, 0 if the ship has no reservation at the port.
+ */
+int shm_demand_get_reserved(shm_general_t *g, shm_demand_t *d, int ship_id, int port_id, int cargo_id);
+
+/**
+ * @brief Reserves part of the demand of a port for a ship leaving for it,
+ * 	the previous reservation of the ship is committed first.
+ * @param d Pointer to shared memory for demand.
+ * @param g Pointer to general SHM.
+ * @param ship_id Ship ID.
+ * @param port_id Port ID.
+ * @param quantity Quantity to reserve by cargo type.
+ * @param expire_day Last day of the reservation, see shm_demand_expire_reservations().
+ */
+void shm_demand_reserve(shm_demand_t *d, shm_general_t *g, int ship_id, int port_id,
+			int *quantity, int expire_day);
+
+/**
+ * @brief Releases the reservation of a ship once it sold at the port, or died.
+ * @param d Pointer to shared memory for demand.
+ * @param g Pointer to general SHM.
+ * @param ship_id Ship ID.
+ * @return The port of the reservation released, -1 if the ship had none.
+ */
+int shm_demand_commit(shm_demand_t *d, shm_general_t *g, int ship_id);
+
+/**
+ * @brief Releases the reservations at a port that are past their last day,
+ * 	so a ship that never arrives does not hold the demand forever.
+ * @param d Pointer to shared memory for demand.
+ * @param g Pointer to general SHM.
+ * @param port_id Port ID.
+ */
+void shm_demand_expire_reservations(shm_demand_t *d, shm_general_t *g, int port_id);
+
 /**
  * @brief Deletes the shared memory for both offers and demands.
  * @param g Pointer to general SHM.
@@ -118,7 +275,8 @@ void shm_demand_remove_quantity(shm_demand_t *d, shm_general_t *g, int id, int t
 void shm_offer_demand_delete(shm_general_t *g);
 
 /**
- * @brief Generates random offers and demands.
+ * @brief Generates random offers and demands, the daily fill is split among
+ * 	the cargo types of the row in one pass with one counter update per type.
  * @param o Pointer to shared memory for offers.
  * @param d Pointer to shared memory for demands.
  * @param l Array of cargo lists.
@@ -136,7 +294,8 @@ void shm_offer_demand_generate(shm_offer_t *o, shm_demand_t *d, o_list_t **l,
  * @param g Pointer to general SHM.
  * @param o Pointer to shared memory for offers.
  * @param cargo_type The id of the cargo.
- * @return the ID of the port that offered the highest quantity of the specified cargo.
+ * @return the ID of the port that offered the highest quantity of the specified cargo,
+ * 	-1 if no port trades it.
  */
 int shm_offer_get_dump_highest(shm_general_t *g, shm_offer_t *o, int cargo_type);
 
@@ -145,7 +304,8 @@ int shm_offer_get_dump_highest(shm_general_t *g, shm_offer_t *o, int cargo_type)
  * @param g Pointer to general SHM.
  * @param d Pointer to shared memory for demands.
  * @param cargo_type The id of the cargo.
- * @return the ID of the port that demanded the highest quantity of the specified cargo.
+ * @return the ID of the port that demanded the highest quantity of the specified cargo,
+ * 	-1 if no port trades it.
  */
 int shm_demand_get_dump_highest(shm_general_t *g, shm_demand_t *o, int cargo_type);
 
@@ -21,12 +21,28 @@ typedef struct shm_port shm_port_t;
  */
 shm_port_t *shm_port_initialize(shm_general_t *g);
 
+/**
+ * @brief Gets the size of the shared memory segment for port data.
+ * @param g Pointer to the general shared memory structure.
+ * @return The size in bytes.
+ */
+size_t shm_port_get_segment_size(shm_general_t *g);
+
 /**
  * @brief Initializes ipc related to port shm.
  * @param g Pointer to general shared memory structure.
  * @param p Pointer to port share memory structure.
+ * @return TRUE on success, FALSE if the dock semaphores could not be created.
+ */
+bool_t shm_port_ipc_init(shm_general_t *g, shm_port_t *p);
+
+/**
+ * @brief Recreates the dock semaphores of restored ports, keeping their number of docks.
+ * @param g Pointer to general shared memory structure.
+ * @param p Pointer to port share memory structure.
+ * @return TRUE on success, FALSE if the dock semaphores could not be created.
  */
-void shm_port_ipc_init(shm_general_t *g, shm_port_t *p);
+bool_t shm_port_ipc_restore(shm_general_t *g, shm_port_t *p);
 
 /**
  * @brief Attaches the process to the shared memory segment for port data.
@@ -88,6 +104,112 @@ void shm_port_set_coordinates(shm_port_t *p, int port_id, struct coord coord);
  */
 void shm_port_set_is_in_swell(shm_port_t *p, int port_id, bool_t value);
 
+/**
+ * @brief Starts an update of the coordinates or of the market row (offer and
+ * 	demand) of a port, only the port itself writes them.
+ *
+ * 	Readers are lock-free: they take the sequence counter with
+ * 	shm_port_read_begin(), read, and retry if shm_port_read_retry() says
+ * 	that an update ran meanwhile.
+ *
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ */
+void shm_port_write_begin(shm_port_t *p, int port_id);
+
+/**
+ * @brief Ends an update started by shm_port_write_begin().
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ */
+void shm_port_write_end(shm_port_t *p, int port_id);
+
+/**
+ * @brief Makes the readers of the market row of a port retry after a ship
+ * 	changed the demand reserved there, which happens outside the updates
+ * 	of the port. The parity of the sequence counter is kept.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ */
+void shm_port_market_changed(shm_port_t *p, int port_id);
+
+/**
+ * @brief Starts a consistent read of the coordinates or of the market row of a port.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @return The sequence counter to pass to shm_port_read_retry().
+ */
+unsigned int shm_port_read_begin(shm_port_t *p, int port_id);
+
+/**
+ * @brief Checks whether a read started by shm_port_read_begin() must be repeated.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @param seq The sequence counter returned by shm_port_read_begin().
+ * @return TRUE if the port was updated during the read.
+ */
+bool_t shm_port_read_retry(shm_port_t *p, int port_id, unsigned int seq);
+
+/**
+ * @brief Publishes that the port processed a day: expired lots removed and
+ * 	new offer and demand generated. Releases the port from the day barrier.
+ * @param g Pointer to the shm_general_t structure.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @param day The processed day.
+ */
+void shm_port_publish_day(shm_general_t *g, shm_port_t *p, int port_id, int day);
+
+/**
+ * @brief Waits until the port processed the current day if it is more than
+ * 	SO_DAY_LAG days behind; does nothing when SO_DAY_LAG is -1.
+ * @param g Pointer to the shm_general_t structure.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port the caller is going to trade with.
+ */
+void shm_port_wait_day(shm_general_t *g, shm_port_t *p, int port_id);
+
+/**
+ * @brief Counts a ship in the queue of a port before it asks for a dock.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ */
+void shm_port_enter_queue(shm_port_t *p, int port_id);
+
+/**
+ * @brief Removes a ship from the queue of a port once it left the dock.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @param service_days Days the ship kept the dock, a negative value if it
+ * 	never got one; it updates the moving average of the service time.
+ */
+void shm_port_leave_queue(shm_port_t *p, int port_id, double service_days);
+
+/**
+ * @brief Estimates how long a ship arriving at a port will wait for a dock.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @param travel_time Days before the ship arrives.
+ * @return The expected wait in days.
+ */
+double shm_port_get_expected_wait(shm_port_t *p, int port_id, double travel_time);
+
+/**
+ * @brief Gets the number of ships waiting for a dock or docked at a port.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @return The queue depth.
+ */
+int shm_port_get_queue(shm_port_t *p, int port_id);
+
+/**
+ * @brief Gets the moving average of the time a ship keeps a dock at a port.
+ * @param p Pointer to the array of port data in shared memory.
+ * @param port_id Identifier of the port.
+ * @return The service time in days.
+ */
+double shm_port_get_service_days(shm_port_t *p, int port_id);
+
 /**
  * @brief Updates the number of available cargo at a specific port in the dump.
  * @param g Pointer to the shm_general_t structure.
@@ -19,6 +19,13 @@ typedef struct shm_ship shm_ship_t;
  */
 shm_ship_t *shm_ship_initialize(shm_general_t *g);
 
+/**
+ * @brief Gets the size of the shared memory segment for ship data.
+ * @param g Pointer to the general shared memory structure.
+ * @return The size in bytes.
+ */
+size_t shm_ship_get_segment_size(shm_general_t *g);
+
 /**
  * @brief Attaches the process to the shared memory segment for ship data.
  * @param g Pointer to the general shared memory structure.
@@ -205,8 +212,9 @@ void shm_ship_update_capacity(shm_ship_t *s, int ship_id, int update_value);
  * @param c Pointer to the array of shared cargo data structures.
  * @param cargo_hold Array of cargo lists representing the cargo hold of each ship.
  * @param ship_id The identifier of the ship from which expired cargo is to be removed.
+ * @return The expiration date of the oldest lot left in the hold, INT_MAX if it is empty.
  */
-void shm_ship_remove_expired(shm_general_t *g, shm_ship_t *s, shm_cargo_t *c, o_list_t **cargo_hold, int ship_id);
+int shm_ship_remove_expired(shm_general_t *g, shm_ship_t *s, shm_cargo_t *c, o_list_t **cargo_hold, int ship_id);
 
 /**
  * @brief Removes cargo from a ship's cargo hold during a maelstrom event.
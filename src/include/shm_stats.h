@@ -0,0 +1,145 @@
+#ifndef OS_PROJECT_SHM_STATS_H
+#define OS_PROJECT_SHM_STATS_H
+
+#include "../../lib/histogram.h"
+
+#include "shm_general.h"
+
+/**
+ * @brief Latencies tracked by the simulation.
+ */
+enum latency {
+	/* Ship side */
+	LAT_SELL_RTT,		/* msgsnd -> last msgrcv of a sell request */
+	LAT_BUY_RTT,		/* msgsnd -> last msgrcv of a buy request */
+	LAT_DOCK_WAIT,		/* time spent waiting for a free dock */
+	/* Port side */
+	LAT_PORT_RESPONSE,	/* time spent serving a single request */
+	LAT_DAY_REACTION,	/* day tick -> port starts the new day */
+	/* Master side */
+	LAT_DAY_FANOUT,		/* day tick -> SIGDAY sent to every port */
+	LAT_NUM
+};
+
+/**
+ * @brief Counters tracked by the simulation.
+ */
+enum counter {
+	CNT_TRADES,		/* requests that moved some cargo */
+	CNT_MSG_SENT,
+	CNT_MSG_RECEIVED,
+	CNT_VOYAGES,		/* arrivals of a ship with cargo to sell */
+	CNT_DELIVERED,		/* units of cargo sold by the ships */
+	CNT_PORT_SYSCALLS,	/* msgrcv, msgsnd, semop and sigprocmask calls of the ports serving requests */
+	CNT_NUM
+};
+
+/**
+ * @brief Represents the shared memory structure for per process statistics.
+ *
+ * Every process owns a slot and is the only one writing into it,
+ * so no synchronization is needed.
+ */
+typedef struct shm_stats shm_stats_t;
+
+/**
+ * @brief Initializes and attaches shared memory for statistics.
+ * @param g Pointer to the general shared memory structure.
+ * @return Pointer to the attached statistics or NULL on failure.
+ */
+shm_stats_t *shm_stats_initialize(shm_general_t *g);
+
+/**
+ * @brief Attaches the process to the shared memory segment for statistics.
+ * @param g Pointer to the general shared memory structure.
+ * @return Pointer to the attached statistics.
+ */
+shm_stats_t *shm_stats_attach(shm_general_t *g);
+
+/**
+ * @brief Detaches the process from the shared memory segment for statistics.
+ * @param s Pointer to the statistics.
+ */
+void shm_stats_detach(shm_stats_t *s);
+
+/**
+ * @brief Deletes the shared memory segment for statistics.
+ * @param g Pointer to the general shared memory structure.
+ */
+void shm_stats_delete(shm_general_t *g);
+
+/**
+ * @brief Gets the slot owned by a port, the ports own the first slots.
+ * @param port_id Identifier of the port.
+ * @return The slot index.
+ */
+int shm_stats_port_slot(int port_id);
+
+/**
+ * @brief Gets the slot owned by a ship.
+ * @param g Pointer to the general shared memory structure.
+ * @param ship_id Identifier of the ship.
+ * @return The slot index.
+ */
+int shm_stats_ship_slot(shm_general_t *g, int ship_id);
+
+/**
+ * @brief Gets the slot owned by the master.
+ * @param g Pointer to the general shared memory structure.
+ * @return The slot index.
+ */
+int shm_stats_master_slot(shm_general_t *g);
+
+/**
+ * @brief Records a latency sample in a slot.
+ * @param s Pointer to the statistics.
+ * @param slot The slot owned by the calling process.
+ * @param type The latency type.
+ * @param start_ns The start of the measured interval, from get_time_ns().
+ */
+void shm_stats_record_since(shm_stats_t *s, int slot, enum latency type, unsigned long start_ns);
+
+/**
+ * @brief Adds a value to a counter of a slot.
+ * @param s Pointer to the statistics.
+ * @param slot The slot owned by the calling process.
+ * @param type The counter type.
+ * @param value The value to add.
+ */
+void shm_stats_count(shm_stats_t *s, int slot, enum counter type, unsigned long value);
+
+/**
+ * @brief Gets a counter of a single slot.
+ * @param s Pointer to the statistics.
+ * @param slot The slot.
+ * @param type The counter type.
+ * @return The value of the counter.
+ */
+unsigned long shm_stats_get_count(shm_stats_t *s, int slot, enum counter type);
+
+/**
+ * @brief Sums a counter over every slot.
+ * @param g Pointer to the general shared memory structure.
+ * @param s Pointer to the statistics.
+ * @param type The counter type.
+ * @return The total of the counter.
+ */
+unsigned long shm_stats_get_total(shm_general_t *g, shm_stats_t *s, enum counter type);
+
+/**
+ * @brief Merges the histograms of every slot for a latency type.
+ * @param g Pointer to the general shared memory structure.
+ * @param s Pointer to the statistics.
+ * @param type The latency type.
+ * @param out The histogram where the result is stored.
+ */
+void shm_stats_merge(shm_general_t *g, shm_stats_t *s, enum latency type, struct histogram *out);
+
+/**
+ * @brief Gets the human readable name of a latency type.
+ * @param type The latency type.
+ * @return The name of the latency type.
+ */
+const char *shm_stats_get_name(enum latency type);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef OS_PROJECT_SWEEP_H
+#define OS_PROJECT_SWEEP_H
+
+#include <stddef.h>
+
+#include "shm_general.h"
+#include "types.h"
+
+#define SWEEP_MAX_PARAMS 8
+#define SWEEP_MAX_VALUES 32
+#define SWEEP_NAME_LEN 24
+#define SWEEP_MAX_JOBS 64
+
+/**
+ * @brief Grid of overrides of the simulation constants.
+ *
+ * 	Every combination of the values is a variant, the last parameter
+ * 	changes first.
+ */
+struct sweep {
+	int n_params;
+	char names[SWEEP_MAX_PARAMS][SWEEP_NAME_LEN];
+	int index[SWEEP_MAX_PARAMS];	/* from get_constant_index() */
+	int n_values[SWEEP_MAX_PARAMS];
+	double values[SWEEP_MAX_PARAMS][SWEEP_MAX_VALUES];
+};
+
+/**
+ * @brief Parses a grid like "SO_BANCHINE=1,2,4 SO_SPEED=100,500",
+ * 	parameters can also be separated by ';'.
+ * @param s The grid to fill.
+ * @param grid The string to parse.
+ * @return TRUE on success, FALSE if the grid is not valid.
+ */
+bool_t sweep_parse(struct sweep *s, const char *grid);
+
+/**
+ * @brief Gets the number of variants of the grid.
+ * @param s The grid.
+ * @return The number of variants.
+ */
+int sweep_get_variants(struct sweep *s);
+
+/**
+ * @brief Overrides the constants with the values of a variant.
+ * @param s The grid.
+ * @param variant The variant, lower than sweep_get_variants().
+ * @param g Pointer to the general shared memory structure.
+ */
+void sweep_apply(struct sweep *s, int variant, shm_general_t *g);
+
+/**
+ * @brief Writes the overrides of a variant like "SO_BANCHINE=1 SO_SPEED=500".
+ * @param s The grid.
+ * @param variant The variant.
+ * @param buf Where the description is stored.
+ * @param size Size of buf.
+ */
+void sweep_describe(struct sweep *s, int variant, char *buf, size_t size);
+
+#endif
@@ -2,6 +2,9 @@
 #define OS_PROJECT_UTILS_H
 
 #include <stdlib.h>
+#include <sys/ipc.h>
+
+#include "types.h"
 
 /**
  * @return a random integer between min and max (included).
@@ -23,6 +26,11 @@
  */
 #define MIN(x,y) ((x) < (y) ? (x) : (y))
 
+/**
+ * @return the maximum value between x and y.
+ */
+#define MAX(x,y) ((x) > (y) ? (x) : (y))
+
 /**
  * @brief converts time data to timespec and calls nanosleep().
  *
@@ -30,4 +38,83 @@
  */
 void convert_and_sleep(double time_required);
 
+/**
+ * @brief Same as convert_and_sleep(), calling on_interrupt every time a
+ * 	signal interrupts the sleep before sleeping the time left.
+ *
+ * @param time_required time required to terminate.
+ * @param on_interrupt function called after a signal, NULL for none.
+ */
+void convert_and_sleep_interruptible(double time_required, void (*on_interrupt)(void));
+
+/**
+ * @brief reads the monotonic clock.
+ *
+ * @return the current time in nanoseconds.
+ */
+unsigned long get_time_ns(void);
+
+/**
+ * @brief Sets the IPC namespace of the process, keys returned by
+ * 	ipc_key() are unique to it. The namespace 0 gives the keys of const.h.
+ *
+ * @param ns the namespace, only the bits in IPC_NS_MASK are used.
+ */
+void ipc_set_namespace(int ns);
+
+/**
+ * @return the IPC namespace of the process.
+ */
+int ipc_get_namespace(void);
+
+/**
+ * @brief Claims a namespace that no other simulation uses, starting from ns
+ * 	and trying the following ones. A namespace is claimed by creating
+ * 	its SEM_NAMESPACE_KEY array with IPC_EXCL, the namespace 0 is never claimed.
+ *
+ * @param ns the first namespace tried.
+ * @param tries the namespaces tried, 1 to accept only ns.
+ * @return the namespace claimed, -1 if none was free.
+ */
+int ipc_claim_namespace(int ns, int tries);
+
+/**
+ * @brief Releases a namespace claimed by ipc_claim_namespace().
+ *
+ * @param ns the namespace.
+ */
+void ipc_release_namespace(int ns);
+
+/**
+ * @brief Lets the semaphores and queues left in the namespace by a previous
+ * 	run be reused, only the variants of a sweep run one after the other
+ * 	in the same namespace. By default they are created with IPC_EXCL.
+ *
+ * @param reuse TRUE to reuse them.
+ */
+void ipc_set_reuse(bool_t reuse);
+
+/**
+ * @return TRUE if the IPC objects of a previous run may be reused.
+ */
+bool_t ipc_get_reuse(void);
+
+/**
+ * @brief creates a semaphore array in the namespace of the process, or
+ * 	gets the one left by a previous run if ipc_set_reuse() allows it.
+ *
+ * @param base the key of the array in const.h.
+ * @param nsems number of semaphores in the array.
+ * @return the id of the array, -1 on failure.
+ */
+int ipc_sem_create(key_t base, int nsems);
+
+/**
+ * @brief derives the key of an IPC object in the namespace of the process.
+ *
+ * @param base one of the keys in const.h.
+ * @return the key in the current namespace.
+ */
+key_t ipc_key(key_t base);
+
 #endif
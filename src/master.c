@@ -8,6 +8,8 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
 
 #include "../lib/semaphore.h"
 
@@ -18,6 +20,16 @@
 #include "include/shm_cargo.h"
 #include "include/shm_offer_demand.h"
 #include "include/msg_commerce.h"
+#include "include/shm_stats.h"
+#include "include/utils.h"
+#include "include/checkpoint.h"
+#include "include/sweep.h"
+#include "include/route.h"
+
+#define CHECKPOINT_POLL_NS 1000000	/* between two checks of the processes joined */
+#define CHECKPOINT_RESIGNAL 10	/* polls before the processes are signaled again */
+#define CHECKPOINT_MAX_POLLS 5000	/* polls before the snapshot is given up */
+#define NAMESPACE_TRIES 64	/* namespaces tried after the pid of the master */
 
 struct state {
 	shm_general_t *general;
@@ -26,42 +38,173 @@ struct state {
 	shm_cargo_t *cargo;
 	shm_offer_t *offer;
 	shm_demand_t *demand;
+	shm_stats_t *stats;
 	pid_t weather;
+	pid_t ports_group, ships_group;	/* process groups, signaled at once */
+	pid_t pid;		/* the master that claimed the namespace, see init_namespace() */
+	int ns;
+	unsigned long start_ns;
+
+	char *checkpoint_path;
+	int checkpoint_interval;
+
+	struct sweep sweep;
+	int variant;		/* -1 when not running a sweep */
+	int jobs;		/* variants run in parallel */
+	char *sweep_out;
 };
 
 void signal_handler(int signal);
 void signal_handler_init(void);
 
+void parse_args(int argc, char *argv[], char **config, char **restore, char **grid);
+void init_state(char *config);
+void restore_state(char *path);
+
+void init_namespace(void);
+void release_namespace(void);
+void run_sweep(char *grid);
+void delete_sweep_ipc(void);
+
 void run_ports(void);
 void run_ships(void);
 void run_weather(void);
 
-pid_t run_process(char *name, int index);
+pid_t run_process(char *name, int index, pid_t group);
+void signal_group(pid_t group, int signal);
 
 void print_daily_report(void);
 void print_final_report(void);
+void print_region_report(void);
+void print_latency_report(void);
+void print_run_summary(void);
+void write_sweep_row(const char *summary);
 bool_t check_ships_all_dead(void);
 
+void take_checkpoint(void);
+bool_t wait_checkpoint_joined(pid_t group, int n_processes, bool_t ships);
+
 void close_all(void);
 
 struct state state;
 
 int main(int argc, char *argv[])
 {
+	char *config, *restore, *grid;
+
 	signal_handler_init();
 
+	parse_args(argc, argv, &config, &restore, &grid);
+	init_namespace();
+	if (grid != NULL)
+		run_sweep(grid);
+
 	srand(time(NULL) * getpid());
-	state.general = read_from_path("../constants.txt", &state.general);
+	if (restore != NULL)
+		restore_state(restore);
+	else
+		init_state(config);
+
+	run_ports();
+	run_ships();
+	run_weather();
+
+	sem_execute_semop(sem_port_init_get_id(state.general), 0, 0, 0);
+	sem_execute_semop(sem_start_get_id(state.general), 0, -1, 0);
+	state.start_ns = get_time_ns();
+
+	alarm(1);
+
+	while (1) {
+		pause();
+	}
+}
+
+/**
+ * @brief Parses the command line:
+ * 	master [-c snapshot [-i days]] [-r snapshot] [-s grid [-j jobs] [-o output]] [config]
+ */
+void parse_args(int argc, char *argv[], char **config, char **restore, char **grid)
+{
+	int opt;
+
+	*config = "../constants.txt";
+	*restore = NULL;
+	*grid = NULL;
+	state.checkpoint_interval = 1;
+	state.variant = -1;
+	state.jobs = 1;
+	state.sweep_out = "sweep.txt";
+	while ((opt = getopt(argc, argv, "c:i:r:s:j:o:")) != -1) {
+		switch (opt) {
+		case 'c':
+			state.checkpoint_path = optarg;
+			break;
+		case 'i':
+			state.checkpoint_interval = (int)strtol(optarg, NULL, 10);
+			break;
+		case 'r':
+			*restore = optarg;
+			break;
+		case 's':
+			*grid = optarg;
+			break;
+		case 'j':
+			state.jobs = (int)strtol(optarg, NULL, 10);
+			break;
+		case 'o':
+			state.sweep_out = optarg;
+			break;
+		default:
+			dprintf(2, "Usage: %s [-c snapshot [-i days]] [-r snapshot] [-s grid [-j jobs] [-o output]] [config]\n",
+				argv[0]);
+			exit(1);
+		}
+	}
+	if (state.checkpoint_interval <= 0) {
+		dprintf(2, "master.c: The checkpoint interval must be positive.\n");
+		exit(1);
+	}
+	if (state.jobs <= 0 || state.jobs > SWEEP_MAX_JOBS) {
+		dprintf(2, "master.c: The number of jobs must be between 1 and %d.\n", SWEEP_MAX_JOBS);
+		exit(1);
+	}
+	if (optind < argc)
+		*config = argv[optind];
+}
+
+void init_state(char *config)
+{
+	state.general = read_from_path(config, &state.general);
 	if (state.general == NULL) {
 		exit(1);
 	}
-	shm_general_ipc_init(state.general);
+	if (state.variant >= 0) {
+		sweep_apply(&state.sweep, state.variant, state.general);
+		if (!validate_constants(state.general)) {
+			shm_general_delete(shm_general_get_id(state.general));
+			exit(1);
+		}
+	}
+	if (!check_constants(state.general)) {
+		dprintf(2, "master.c: %s does not match the constants of this specialized build.\n", config);
+		shm_general_delete(shm_general_get_id(state.general));
+		exit(1);
+	}
+	if (shm_general_ipc_init(state.general) == FALSE) {
+		dprintf(2, "master.c: Failed to create the semaphores and queues.\n");
+		shm_general_delete(shm_general_get_id(state.general));
+		exit(1);
+	}
 
 	state.ports = shm_port_initialize(state.general);
 	if (state.ports == NULL) {
 		exit(1);
 	}
-	shm_port_ipc_init(state.general, state.ports);
+	if (shm_port_ipc_init(state.general, state.ports) == FALSE) {
+		dprintf(2, "master.c: Failed to create the dock semaphores.\n");
+		exit(1);
+	}
 
 	state.ships = shm_ship_initialize(state.general);
 	if (state.ships == NULL) {
@@ -78,25 +221,201 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	state.demand = shm_demand_init(state.general);
+	state.demand = shm_demand_init(state.general, state.offer);
 	if (state.demand == NULL) {
 		exit(1);
 	}
 
+	state.stats = shm_stats_initialize(state.general);
+	if (state.stats == NULL) {
+		exit(1);
+	}
+}
 
-	run_ports();
-	run_ships();
-	run_weather();
+/**
+ * @brief Recreates the shared segments from a snapshot, statistics start from scratch.
+ */
+void restore_state(char *path)
+{
+	state.general = checkpoint_restore(path, &state.general);
+	if (state.general == NULL) {
+		exit(1);
+	}
+	if (!check_constants(state.general)) {
+		dprintf(2, "master.c: %s does not match the constants of this specialized build.\n", path);
+		exit(1);
+	}
+	if (shm_general_ipc_init(state.general) == FALSE) {
+		dprintf(2, "master.c: Failed to create the semaphores and queues.\n");
+		exit(1);
+	}
 
-	sem_execute_semop(sem_port_init_get_id(state.general), 0, 0, 0);
-	sem_execute_semop(sem_start_get_id(state.general), 0, -1, 0);
+	state.ports = shm_port_attach(state.general);
+	if (shm_port_ipc_restore(state.general, state.ports) == FALSE) {
+		dprintf(2, "master.c: Failed to create the dock semaphores.\n");
+		exit(1);
+	}
+	state.ships = shm_ship_attach(state.general);
+	state.cargo = shm_cargo_attach(state.general);
+	state.offer = shm_offer_attach(state.general);
+	state.demand = shm_demand_attach(state.general);
 
+	state.stats = shm_stats_initialize(state.general);
+	if (state.stats == NULL) {
+		exit(1);
+	}
+	dprintf(1, "Restored day %d from %s.\n", get_current_day(state.general), path);
+}
 
-	alarm(1);
+/**
+ * @brief Claims the IPC namespace of the simulation: SO_IPC_NS if set, the
+ * 	first free one from the pid of the master otherwise. Children get it
+ * 	as second argument. It is released when the master exits.
+ */
+void init_namespace(void)
+{
+	char *env;
+	int ns;
+
+	env = getenv("SO_IPC_NS");
+	if (env != NULL)
+		ns = ipc_claim_namespace((int)strtol(env, NULL, 0), 1);
+	else
+		ns = ipc_claim_namespace(getpid(), NAMESPACE_TRIES);
+	if (ns == -1) {
+		dprintf(2, "master.c: No free IPC namespace%s.\n", env != NULL ? ", SO_IPC_NS is in use" : "");
+		exit(1);
+	}
+	ipc_set_namespace(ns);
+	state.ns = ns;
+	state.pid = getpid();
+	atexit(release_namespace);
+}
 
-	while (1) {
-		pause();
+/**
+ * @brief Releases the namespace of the master, not of its forks.
+ */
+void release_namespace(void)
+{
+	if (getpid() == state.pid)
+		ipc_release_namespace(state.ns);
+}
+
+/**
+ * @brief Runs every variant of the grid, state.jobs at a time. Each variant is
+ * 	run by a child that goes on as a normal master, so this function returns only in it.
+ *
+ * 	Every job claims its own IPC namespace, semaphores and queues are kept
+ * 	between the variants run by the same job and deleted at the end.
+ */
+void run_sweep(char *grid)
+{
+	static struct sigaction sa;
+	pid_t workers[SWEEP_MAX_JOBS];
+	int variants[SWEEP_MAX_JOBS];
+	int job_ns[SWEEP_MAX_JOBS];
+	unsigned long start_ns[SWEEP_MAX_JOBS];
+	char description[256];
+	int i, n_variants, next, running, status, fd, ns;
+	pid_t pid;
+
+	if (sweep_parse(&state.sweep, grid) == FALSE) {
+		dprintf(2, "master.c: Invalid sweep grid \"%s\".\n", grid);
+		exit(1);
+	}
+	fd = open(state.sweep_out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		dprintf(2, "master.c: Failed to create %s.\n", state.sweep_out);
+		exit(1);
+	}
+	close(fd);
+
+	/* Only the variants clean up on SIGINT */
+	bzero(&sa, sizeof(sa));
+	sa.sa_handler = SIG_DFL;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	ns = state.ns + 1;
+	for (i = 0; i < state.jobs; i++) {
+		workers[i] = 0;
+		job_ns[i] = ipc_claim_namespace(ns, NAMESPACE_TRIES);
+		if (job_ns[i] == -1) {
+			dprintf(2, "master.c: No free IPC namespace for job %d.\n", i);
+			while (i-- > 0)
+				ipc_release_namespace(job_ns[i]);
+			exit(1);
+		}
+		ns = job_ns[i] + 1;
+	}
+	n_variants = sweep_get_variants(&state.sweep);
+	next = running = 0;
+	while (next < n_variants || running > 0) {
+		if (next < n_variants && running < state.jobs) {
+			for (i = 0; workers[i] != 0; i++);
+			sweep_describe(&state.sweep, next, description, sizeof(description));
+			dprintf(1, "Variant %d/%d: %s\n", next + 1, n_variants, description);
+			if ((pid = fork()) == -1) {
+				dprintf(2, "master.c: Error in fork.\n");
+				break;
+			} else if (pid == 0) {
+				state.variant = next;
+				ipc_set_namespace(job_ns[i]);
+				/* Left by the previous variant of the job */
+				ipc_set_reuse(TRUE);
+				signal_handler_init();
+				/* Reports of the variants are not printed */
+				fd = open("/dev/null", O_WRONLY);
+				dup2(fd, 1);
+				close(fd);
+				return;
+			}
+			workers[i] = pid;
+			variants[i] = next;
+			start_ns[i] = get_time_ns();
+			next++;
+			running++;
+			continue;
+		}
+
+		pid = wait(&status);
+		for (i = 0; i < state.jobs && workers[i] != pid; i++);
+		if (i == state.jobs)
+			continue;
+		dprintf(1, "Variant %d/%d %s in %.1f s\n", variants[i] + 1, n_variants,
+			WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS ? "done" : "failed",
+			(get_time_ns() - start_ns[i]) / 1e9);
+		workers[i] = 0;
+		running--;
+	}
+
+	for (i = 0; i < state.jobs; i++) {
+		ipc_set_namespace(job_ns[i]);
+		delete_sweep_ipc();
+		ipc_release_namespace(job_ns[i]);
 	}
+	dprintf(1, "Results written in %s.\n", state.sweep_out);
+	exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief Deletes the semaphores and queues of the current namespace.
+ */
+void delete_sweep_ipc(void)
+{
+	key_t sem_keys[] = { SEM_START_KEY, SEM_PORTS_INITIALIZED_KEY, SEM_DOCK_KEY, SEM_CARGO_KEY, SEM_EPOCH_KEY,
+			    SEM_RESERVATION_KEY, SEM_CHECKPOINT_KEY };
+	key_t msg_keys[] = { MSG_IN_PORT_KEY, MSG_OUT_PORT_KEY };
+	int i, shard, id;
+
+	for (i = 0; i < (int)(sizeof(sem_keys) / sizeof(sem_keys[0])); i++)
+		if ((id = semget(ipc_key(sem_keys[i]), 0, 0)) != -1)
+			sem_delete(id);
+	/* The variants may have split the map in a different number of regions */
+	for (i = 0; i < (int)(sizeof(msg_keys) / sizeof(msg_keys[0])); i++)
+		for (shard = 0; shard < SHARD_MAX; shard++)
+			if ((id = msgget(ipc_key(SHARD_KEY(msg_keys[i], shard)), 0)) != -1)
+				msgctl(id, IPC_RMID, NULL);
 }
 
 void signal_handler_init(void)
@@ -122,8 +441,10 @@ void run_ports(void)
 
 	n_port = get_porti(state.general);
 	for (i = 0; i < n_port; i++) {
-		pid = run_process("./port", i);
+		pid = run_process("./port", i, state.ports_group);
 		shm_port_set_pid(state.ports, i, pid);
+		if (state.ports_group == 0)
+			state.ports_group = pid;
 	}
 }
 
@@ -134,8 +455,13 @@ void run_ships(void)
 	pid_t pid;
 
 	for (i = 0; i < n_ship; i++) {
-		pid = run_process("./ship", i);
+		/* Sunk before the snapshot */
+		if (shm_ship_get_is_dead(state.ships, i))
+			continue;
+		pid = run_process("./ship", i, state.ships_group);
 		shm_ship_set_pid(state.ships, i, pid);
+		if (state.ships_group == 0)
+			state.ships_group = pid;
 	}
 }
 
@@ -143,32 +469,53 @@ void run_weather(void)
 {
 	pid_t pid;
 
-	pid = run_process("./weather", 1);
+	pid = run_process("./weather", 1, -1);
 
 	state.weather = pid;
 }
 
-pid_t run_process(char *name, int index)
+/**
+ * @brief Forks and executes a child.
+ * @param group Process group to join, 0 to lead a new one, -1 to stay in the one of the master.
+ */
+pid_t run_process(char *name, int index, pid_t group)
 {
 	pid_t process_pid;
-	char *args[3], buf[10];
+	char *args[4], buf[10], ns[12];
 	if ((process_pid = fork()) == -1) {
 		dprintf(2, "master.c: Error in fork.\n");
 		close_all();
 	} else if (process_pid == 0) {
+		/* Set on both sides, whichever runs first */
+		if (group >= 0)
+			setpgid(0, group);
 		sprintf(buf, "%d", index);
+		sprintf(ns, "%d", ipc_get_namespace());
 		args[0] = name;
 		args[1] = buf;
-		args[2] = NULL;
+		args[2] = ns;
+		args[3] = NULL;
 		if (execve(name, args, NULL) == -1) {
 			perror("execve");
 			exit(EXIT_FAILURE);
 		}
 	}
+	if (group >= 0)
+		setpgid(process_pid, group == 0 ? process_pid : group);
 
 	return process_pid;
 }
 
+/**
+ * @brief Sends a signal to every process of a group with a single kill().
+ */
+void signal_group(pid_t group, int signal)
+{
+	/* killpg(0) would signal the group of the master */
+	if (group > 0)
+		killpg(group, signal);
+}
+
 void print_daily_report(void) {
 	int i, type;
 
@@ -207,6 +554,8 @@ void print_daily_report(void) {
 			shm_port_get_dump_cargo_received(state.ports, i));
 		dprintf(1, "\tDocks used: %d/%d\n",
 			shm_port_get_dump_used_docks(state.ports, i), shm_port_get_docks(state.ports, i));
+		dprintf(1, "\t%d ships in queue, %.2f days at dock on average;\n",
+			shm_port_get_queue(state.ports, i), shm_port_get_service_days(state.ports, i));
 	}
 
 	dprintf(1, "\n**********WEATHER**********\n");
@@ -224,7 +573,7 @@ void print_daily_report(void) {
 }
 
 void print_final_report(void) {
-	int i, type;
+	int i, type, port;
 	int n_port = get_porti(state.general);
 	int n_ship = get_navi(state.general);
 	int n_cargo = get_merci(state.general);
@@ -250,10 +599,17 @@ void print_final_report(void) {
 			shm_cargo_get_dump_expired_on_ship(state.cargo, type));
 		dprintf(1, "\t%d delivered to ports;\n",
 			shm_cargo_get_dump_received_in_port(state.cargo, type));
-		dprintf(1, "\ttop offering port: %d;\n",
-			shm_offer_get_dump_highest(state.general, state.offer, type));
-		dprintf(1, "\ttop requesting port: %d;\n",
-			shm_demand_get_dump_highest(state.general, state.demand, type));
+		/* With SO_SPARSE_MAX a type may be traded by no port */
+		port = shm_offer_get_dump_highest(state.general, state.offer, type);
+		if (port == -1)
+			dprintf(1, "\ttop offering port: none;\n");
+		else
+			dprintf(1, "\ttop offering port: %d;\n", port);
+		port = shm_demand_get_dump_highest(state.general, state.demand, type);
+		if (port == -1)
+			dprintf(1, "\ttop requesting port: none;\n");
+		else
+			dprintf(1, "\ttop requesting port: %d;\n", port);
 	}
 
 	dprintf(1, "\n**********PORTS**********\n");
@@ -277,6 +633,131 @@ void print_final_report(void) {
 	}
 	dprintf(1, "%d ships died due to a maelstrom.\n",
 		shm_ship_get_dump_is_dead(state.ships, n_ship));
+
+	print_region_report();
+	print_latency_report();
+}
+
+/**
+ * @brief Prints the totals of every region, the ports are assigned to the
+ * 	regions the same way they are in route_get_shard().
+ */
+void print_region_report(void)
+{
+	int i, shard, n_regions = get_regions(state.general);
+	int ports[SHARD_MAX], shipped[SHARD_MAX], received[SHARD_MAX];
+	unsigned long trades[SHARD_MAX];
+
+	if (get_shards(state.general) == 0)
+		return;
+	for (shard = 0; shard < n_regions; shard++) {
+		ports[shard] = shipped[shard] = received[shard] = 0;
+		trades[shard] = 0;
+	}
+	for (i = 0; i < get_porti(state.general); i++) {
+		shard = route_get_shard(state.general, shm_port_get_coordinates(state.ports, i));
+		ports[shard]++;
+		shipped[shard] += shm_port_get_dump_cargo_shipped(state.ports, i);
+		received[shard] += shm_port_get_dump_cargo_received(state.ports, i);
+		trades[shard] += shm_stats_get_count(state.stats, shm_stats_port_slot(i), CNT_TRADES);
+	}
+
+	dprintf(1, "\n**********REGIONS**********\n");
+	dprintf(1, "%-8s %8s %10s %12s %12s\n", "region", "ports", "trades", "shipped", "received");
+	for (shard = 0; shard < n_regions; shard++)
+		dprintf(1, "%-8d %8d %10lu %12d %12d\n", shard, ports[shard], trades[shard],
+			shipped[shard], received[shard]);
+}
+
+void print_latency_report(void)
+{
+	struct histogram merged;
+	int type;
+
+	dprintf(1, "\n**********LATENCY**********\n");
+	dprintf(1, "%-16s %10s %12s %12s %12s %12s\n",
+		"(microseconds)", "samples", "p50", "p90", "p99", "max");
+	for (type = 0; type < LAT_NUM; type++) {
+		shm_stats_merge(state.general, state.stats, type, &merged);
+		dprintf(1, "%-16s %10lu %12.1f %12.1f %12.1f %12.1f\n",
+			shm_stats_get_name(type), merged.count,
+			histogram_percentile(&merged, 50) / 1e3,
+			histogram_percentile(&merged, 90) / 1e3,
+			histogram_percentile(&merged, 99) / 1e3,
+			merged.max / 1e3);
+	}
+}
+
+/**
+ * @brief Prints resource usage and throughput of the whole simulation,
+ * 	children included. Must be called after the children are reaped.
+ *
+ * 	The last line is meant to be parsed by bench/run_scenarios.sh.
+ */
+void print_run_summary(void)
+{
+	struct rusage self, children;
+	double wall_s, user_s, sys_s;
+	unsigned long trades, msgs, voyages, delivered, port_syscalls;
+	double per_voyage;
+	long ctx_switches, peak_rss_kb;
+	char summary[512];
+
+	wall_s = (get_time_ns() - state.start_ns) / 1e9;
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+	user_s = self.ru_utime.tv_sec + children.ru_utime.tv_sec
+		+ (self.ru_utime.tv_usec + children.ru_utime.tv_usec) / 1e6;
+	sys_s = self.ru_stime.tv_sec + children.ru_stime.tv_sec
+		+ (self.ru_stime.tv_usec + children.ru_stime.tv_usec) / 1e6;
+	ctx_switches = self.ru_nvcsw + self.ru_nivcsw + children.ru_nvcsw + children.ru_nivcsw;
+	peak_rss_kb = self.ru_maxrss > children.ru_maxrss ? self.ru_maxrss : children.ru_maxrss;
+	trades = shm_stats_get_total(state.general, state.stats, CNT_TRADES);
+	msgs = shm_stats_get_total(state.general, state.stats, CNT_MSG_SENT);
+	voyages = shm_stats_get_total(state.general, state.stats, CNT_VOYAGES);
+	delivered = shm_stats_get_total(state.general, state.stats, CNT_DELIVERED);
+	per_voyage = voyages > 0 ? (double)delivered / voyages : 0;
+	port_syscalls = shm_stats_get_total(state.general, state.stats, CNT_PORT_SYSCALLS);
+
+	dprintf(1, "\n**********RUN SUMMARY**********\n");
+	dprintf(1, "Wall time: %.2f s, CPU time: %.2f s user + %.2f s sys\n", wall_s, user_s, sys_s);
+	dprintf(1, "Context switches: %ld, peak RSS of a process: %ld kB\n", ctx_switches, peak_rss_kb);
+	dprintf(1, "Trades: %lu (%.1f/s), IPC messages: %lu (%.1f/s)\n",
+		trades, trades / wall_s, msgs, msgs / wall_s);
+	dprintf(1, "Voyages with cargo: %lu, units delivered: %lu (%.1f per voyage)\n",
+		voyages, delivered, per_voyage);
+	dprintf(1, "Port syscalls: %lu (%.2f per trade)\n",
+		port_syscalls, trades > 0 ? (double)port_syscalls / trades : 0);
+	sprintf(summary, "wall_s=%.3f user_s=%.3f sys_s=%.3f ctx_switches=%ld peak_rss_kb=%ld "
+		"trades=%lu trades_per_s=%.1f msgs=%lu msgs_per_s=%.1f delivered_per_voyage=%.2f "
+		"port_syscalls_per_trade=%.2f",
+		wall_s, user_s, sys_s, ctx_switches, peak_rss_kb,
+		trades, trades / wall_s, msgs, msgs / wall_s, per_voyage,
+		trades > 0 ? (double)port_syscalls / trades : 0);
+	dprintf(1, "SUMMARY %s\n", summary);
+	if (state.variant >= 0)
+		write_sweep_row(summary);
+}
+
+/**
+ * @brief Appends the summary of the variant to the output of the sweep.
+ */
+void write_sweep_row(const char *summary)
+{
+	char description[256], row[1024];
+	int fd;
+
+	fd = open(state.sweep_out, O_WRONLY | O_APPEND);
+	if (fd == -1) {
+		dprintf(2, "master.c: Failed to open %s.\n", state.sweep_out);
+		return;
+	}
+	sweep_describe(&state.sweep, state.variant, description, sizeof(description));
+	/* A single write, so rows of parallel variants are not mixed */
+	sprintf(row, "variant=%d %s %s\n", state.variant, description, summary);
+	if (write(fd, row, strlen(row)) == -1)
+		dprintf(2, "master.c: Failed to write %s.\n", state.sweep_out);
+	close(fd);
 }
 
 bool_t check_ships_all_dead(void)
@@ -292,6 +773,63 @@ bool_t check_ships_all_dead(void)
 	return res;
 }
 
+/**
+ * @brief Takes a snapshot before the day tick: the ships stop between two
+ * 	trades first, then the ports between two batches of requests, so
+ * 	that the segments and every hold are saved at the same point.
+ */
+void take_checkpoint(void)
+{
+	int i;
+
+	if (checkpoint_begin(state.general, state.checkpoint_path) == FALSE)
+		return;
+	set_checkpoint_phase(state.general, CHECKPOINT_SHIPS);
+	if (wait_checkpoint_joined(state.ships_group, get_navi(state.general), TRUE) == FALSE) {
+		checkpoint_cancel(state.general);
+		return;
+	}
+	/* No ship can send requests anymore */
+	set_checkpoint_phase(state.general, CHECKPOINT_PORTS);
+	if (wait_checkpoint_joined(state.ports_group, get_porti(state.general), FALSE) == FALSE) {
+		checkpoint_cancel(state.general);
+		return;
+	}
+	/* The sunk ships are not run again on restore */
+	for (i = 0; i < get_navi(state.general); i++)
+		if (shm_ship_get_is_dead(state.ships, i))
+			checkpoint_save_hold(state.general, checkpoint_ship_slot(state.general, i), NULL);
+	checkpoint_end(state.general);
+}
+
+/**
+ * @brief Waits for the processes of a group to join the current phase of the
+ * 	checkpoint, signaling them again in case a signal came before they blocked.
+ * @param ships TRUE if the sunk ships count as joined.
+ * @return FALSE if they did not join within CHECKPOINT_MAX_POLLS polls.
+ */
+bool_t wait_checkpoint_joined(pid_t group, int n_processes, bool_t ships)
+{
+	struct timespec poll_time;
+	int i, n_joined;
+
+	poll_time.tv_sec = 0;
+	poll_time.tv_nsec = CHECKPOINT_POLL_NS;
+	for (i = 0; i < CHECKPOINT_MAX_POLLS; i++) {
+		if (i % CHECKPOINT_RESIGNAL == 0)
+			signal_group(group, SIGDAY);
+		nanosleep(&poll_time, NULL);
+		n_joined = get_checkpoint_joined(state.general);
+		if (ships)
+			n_joined += shm_ship_get_dump_is_dead(state.ships, n_processes);
+		if (n_joined >= n_processes)
+			return TRUE;
+	}
+	dprintf(2, "master.c: The processes did not join the checkpoint of day %d.\n",
+		get_checkpoint_day(state.general));
+	return FALSE;
+}
+
 void signal_handler(int signal)
 {
 	switch (signal) {
@@ -312,8 +850,14 @@ void signal_handler(int signal)
 			close_all();
 		}
 
+		if (state.checkpoint_path != NULL
+		    && (get_current_day(state.general) + 1) % state.checkpoint_interval == 0)
+			take_checkpoint();
+
 		increase_day(state.general);
-		shm_port_send_signal_to_all_ports(state.ports, state.general, SIGDAY);
+		signal_group(state.ports_group, SIGDAY);
+		shm_stats_record_since(state.stats, shm_stats_master_slot(state.general),
+				       LAT_DAY_FANOUT, get_day_tick_ns(state.general));
 		kill(state.weather, SIGDAY);
 		alarm(1);
 		break;
@@ -327,22 +871,22 @@ void close_all(void)
 	print_final_report();
 
 	kill(state.weather, SIGINT);
-	shm_ship_send_signal_to_all_ships(state.ships, state.general, SIGINT);
-	shm_port_send_signal_to_all_ports(state.ports, state.general, SIGINT);
+	signal_group(state.ships_group, SIGINT);
+	signal_group(state.ports_group, SIGINT);
 	while (wait(NULL) > 0);
+	print_run_summary();
 
-	msgctl(msg_in_get_id(state.general), IPC_RMID, NULL);
-	msgctl(msg_out_get_id(state.general), IPC_RMID, NULL);
-
-	sem_delete(sem_start_get_id(state.general));
-	sem_delete(sem_port_init_get_id(state.general));
-	sem_delete(shm_port_get_sem_docks_id(state.ports));
-	sem_delete(sem_cargo_get_id(state.general));
+	/* Semaphores and queues of a sweep are reused by the next variant */
+	if (state.variant < 0) {
+		shm_general_ipc_delete(state.general);
+		sem_delete(shm_port_get_sem_docks_id(state.ports));
+	}
 
 	shm_port_delete(state.general);
 	shm_ship_delete(state.general);
 	shm_offer_demand_delete(state.general);
 	shm_cargo_delete(state.general);
+	shm_stats_delete(state.general);
 
 	shm_general_delete(shm_general_get_id(state.general));
 
@@ -4,23 +4,48 @@
 
 #include "include/msg_commerce.h"
 #include "include/const.h"
+#include "include/utils.h"
+
+#include <stddef.h>
 
 #define MSG_SIZE (sizeof(struct commerce_msg) - sizeof(long))
+/* Size of a message without the lots it does not carry */
+#define MSG_USED_SIZE(msg) (offsetof(struct commerce_msg, lots) - sizeof(long) \
+			    + sizeof(struct commerce_lot) * (msg)->n_lots)
 #define MSG_TYPE(type) ((type) + 1)
 
-int msg_commerce_in_port_init(void)
+static int msg_commerce_queue_init(key_t key);
+
+int msg_commerce_in_port_init(int shard)
 {
 	int id;
-	if ((id = msgget(MSG_IN_PORT_KEY, 0660 | IPC_CREAT | IPC_EXCL)) < 0)
+	if ((id = msg_commerce_queue_init(ipc_key(SHARD_KEY(MSG_IN_PORT_KEY, shard)))) < 0)
 		dprintf(2, "msg_commerce.c - msg_commerce_in_port_init: Failed to create message queue.\n");
 	return id;
 }
 
-int msg_commerce_out_port_init(void)
+int msg_commerce_out_port_init(int shard)
 {
 	int id;
-	if ((id = msgget(MSG_OUT_PORT_KEY, 0660 | IPC_CREAT | IPC_EXCL)) < 0)
-		dprintf(2, "msg_commerce.c - msg_commerce_in_port_init: Failed to create message queue.\n");
+	if ((id = msg_commerce_queue_init(ipc_key(SHARD_KEY(MSG_OUT_PORT_KEY, shard)))) < 0)
+		dprintf(2, "msg_commerce.c - msg_commerce_out_port_init: Failed to create message queue.\n");
+	return id;
+}
+
+/**
+ * @brief Creates the queue, or reuses the one left by a previous variant of
+ * 	a sweep dropping the messages still in it, see ipc_set_reuse().
+ */
+static int msg_commerce_queue_init(key_t key)
+{
+	struct commerce_msg msg;
+	int id;
+
+	if (!ipc_get_reuse())
+		return msgget(key, 0660 | IPC_CREAT | IPC_EXCL);
+	if ((id = msgget(key, 0660 | IPC_CREAT)) < 0)
+		return id;
+	while (msgrcv(id, &msg, MSG_SIZE, 0, IPC_NOWAIT) >= 0);
 	return id;
 }
 
@@ -35,6 +60,7 @@ struct commerce_msg msg_commerce_create(long receiver_id, long sender_id,
 	res.quantity = quantity;
 	res.expiry_date = expiry_date;
 	res.status = status;
+	res.n_lots = 0;
 	return res;
 }
 
@@ -42,10 +68,23 @@ void msg_commerce_send(int queue_id, struct commerce_msg *msg)
 {
 	int ret;
 	do {
-		ret = msgsnd(queue_id, msg, MSG_SIZE, 0);
+		ret = msgsnd(queue_id, msg, MSG_USED_SIZE(msg), 0);
 	} while (ret < 0);
 }
 
+bool_t msg_commerce_add_lot(struct commerce_msg *msg, int quantity, int expiry_date)
+{
+	msg->lots[msg->n_lots].quantity = quantity;
+	msg->lots[msg->n_lots].expiry_date = expiry_date;
+	msg->quantity += quantity;
+	return ++msg->n_lots == MSG_LOTS;
+}
+
+bool_t msg_commerce_receive_msg(int queue_id, int type, struct commerce_msg *msg, bool_t wait)
+{
+	return msgrcv(queue_id, msg, MSG_SIZE, MSG_TYPE(type), wait ? 0 : IPC_NOWAIT) >= 0;
+}
+
 bool_t msg_commerce_receive(int queue_id, int type, int *sender_id,
 			    int *cargo_id, int *quantity, int *expiry_date,
 			    int *status, bool_t restarting)
@@ -1,11 +1,13 @@
 #define _GNU_SOURCE
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "../lib/semaphore.h"
 
@@ -18,6 +20,22 @@
 #include "include/shm_offer_demand.h"
 #include "include/cargo_list.h"
 #include "include/msg_commerce.h"
+#include "include/shm_stats.h"
+#include "include/checkpoint.h"
+#include "include/route.h"
+
+/**
+ * @brief A request of a ship and the quantity the port exchanges for it.
+ */
+struct request {
+	int ship_id;
+	int cargo_type;
+	int amount;
+	int status;
+	int exchanged;
+};
+
+#define PORT_BATCH 32	/* requests drained from the queue before the day is checked again */
 
 struct state {
 	int id;
@@ -28,17 +46,65 @@ struct state {
 	shm_offer_t *offer;
 	shm_demand_t *demand;
 	o_list_t **cargo_hold;
+	shm_stats_t *stats;
+	int stats_slot;
+	int shard;		/* region whose queues the port serves, see route_get_shard() */
 
 	int current_day;
+	int joined_day;		/* day of the last checkpoint joined */
+
+	/* Requests drained from the queue, see serve_batch() */
+	struct request batch[PORT_BATCH];
+	int *batch_received, *batch_shipped;	/* by cargo type */
+
+	/* Dock workers, see start_workers() */
+	pthread_t *workers;
+	int n_workers;
+	pthread_rwlock_t gate;		/* taken for writing by the day and the swell */
+	pthread_mutex_t market_lock;	/* writers of the market row and of the dumps of the port */
+	pthread_mutex_t *cargo_lock;	/* by cargo type, for the hold */
+	pthread_mutex_t stats_lock;
+	pthread_mutex_t pool_lock;
 };
 
 void signal_handler(int signal);
 void signal_handler_init(void);
 void loop(void);
+void start_day(void);
+void join_checkpoint(void);
+void serve_request(int ship_id, int cargo_type, int amount, int status);
+void swell(void);
+
+bool_t start_workers(void);
+void *serve_docks(void *arg);
+void serve_signals(void);
+
+/**
+ * @brief Destination of the lots sold to a ship.
+ */
+struct lot_reply {
+	int msg_out_id;
+	struct commerce_msg msg;	/* lots not sent yet */
+};
 
 void respond_ship_msg(int ship_id, int cargo_type, int amount, int status);
+void serve_batch(int n);
+void apply_request(struct request *req);
+void reply_request(struct request *req);
+void update_cargo_dumps(int cargo_type, int received, int shipped);
+void send_reply(int msg_out_id, struct commerce_msg *msg);
+void send_lot(int quantity, int expire, bool_t last, void *arg);
+
+void stats_count(enum counter type, unsigned long value);
+void stats_record_since(enum latency type, unsigned long start_ns);
+void pool_lock(void);
+void pool_unlock(void);
 
 void generate_coordinates(void);
+void restore_hold(void);
+
+void market_write_begin(void);
+void market_write_end(void);
 
 void close_all(void);
 
@@ -51,7 +117,9 @@ int main(int argc, char *argv[])
 	signal_handler_init();
 
 	state.id = (int)strtol(argv[1], NULL, 10);
+	state.joined_day = -1;
 
+	ipc_set_namespace((int)strtol(argv[2], NULL, 10));
 	shm_general_attach(&state.general);
 	if (state.general == NULL) {
 		close_all();
@@ -61,14 +129,27 @@ int main(int argc, char *argv[])
 	state.cargo = shm_cargo_attach(state.general);
 	state.offer = shm_offer_attach(state.general);
 	state.demand = shm_demand_attach(state.general);
+	state.stats = shm_stats_attach(state.general);
+	state.stats_slot = shm_stats_port_slot(state.id);
 	state.cargo_hold = malloc(sizeof(state.cargo_hold) * get_merci(state.general));
+	state.cargo_lock = malloc(sizeof(pthread_mutex_t) * get_merci(state.general));
+	state.batch_received = calloc(get_merci(state.general), sizeof(int));
+	state.batch_shipped = calloc(get_merci(state.general), sizeof(int));
 	for (i = 0; i < get_merci(state.general); i++) {
 		state.cargo_hold[i] = cargo_list_create();
+		pthread_mutex_init(&state.cargo_lock[i], NULL);
 	}
+	pthread_mutex_init(&state.market_lock, NULL);
+	pthread_mutex_init(&state.stats_lock, NULL);
+	pthread_mutex_init(&state.pool_lock, NULL);
 
 
 	srand(time(NULL) * getpid());
-	generate_coordinates();
+	if (get_restore_day(state.general) >= 0)
+		restore_hold();
+	else
+		generate_coordinates();
+	state.shard = route_get_shard(state.general, shm_port_get_coordinates(state.port, state.id));
 
 	sem_execute_semop(sem_port_init_get_id(state.general), 0, -1, 0);
 	sem_execute_semop(sem_start_get_id(state.general), 0, 0, 0);
@@ -78,74 +159,371 @@ int main(int argc, char *argv[])
 
 void loop(void)
 {
-	int msg_in_id = msg_in_get_id(state.general);
-	int ship_id, needed_type, needed_amount, status;
-	int day;
+	int msg_in_id = msg_in_get_id(state.general, state.shard);
+	struct commerce_msg msg;
+	int n;
+
+	/* A restored port starts from the day of the snapshot, see restore_hold() */
+	if (get_restore_day(state.general) < 0) {
+		market_write_begin();
+		shm_offer_demand_generate(state.offer, state.demand, state.cargo_hold, state.id, state.cargo, state.general);
+		market_write_end();
+		shm_port_publish_day(state.general, state.port, state.id, 0);
+	}
+	if (get_dock_workers(state.general) && start_workers())
+		serve_signals();
+	while (1) {
+		start_day();
+		join_checkpoint();
+		/* Waits for a request, then drains the ones already queued */
+		for (n = 0; n < PORT_BATCH; n++) {
+			stats_count(CNT_PORT_SYSCALLS, 1);
+			if (msg_commerce_receive_msg(msg_in_id, state.id, &msg, n == 0) == FALSE)
+				break;
+			state.batch[n].ship_id = (int)msg.sender;
+			state.batch[n].cargo_type = msg.cargo_id;
+			state.batch[n].amount = msg.quantity;
+			state.batch[n].status = msg.status;
+		}
+		if (n > 0)
+			serve_batch(n);
+	}
+}
 
+/**
+ * @brief Dumps the expired lots and generates the offer and demand of the
+ * 	new day, if the day changed since the last call.
+ */
+void start_day(void)
+{
+	int day = get_current_day(state.general);
+
+	if (state.current_day >= day)
+		return;
+	stats_record_since(LAT_DAY_REACTION, get_day_tick_ns(state.general));
+	state.current_day = day;
+	market_write_begin();
+	/* Dumping expired stuff */
+	shm_port_remove_expired(state.general, state.port, state.offer, state.cargo, state.cargo_hold, state.id);
+	shm_port_update_dump_cargo_available(state.general, state.port, state.offer, state.id);
+	/* Generation of new demand/offer */
 	shm_offer_demand_generate(state.offer, state.demand, state.cargo_hold, state.id, state.cargo, state.general);
-	while (1) {
-		day = get_current_day(state.general);
-		if (state.current_day < day) {
-			state.current_day = day;
-			/* Dumping expired stuff */
-			shm_port_remove_expired(state.general, state.port, state.offer, state.cargo, state.cargo_hold, state.id);
-			shm_port_update_dump_cargo_available(state.general, state.port, state.offer, state.id);
-			/* Generation of new demand/offer */
-			shm_offer_demand_generate(state.offer, state.demand, state.cargo_hold, state.id, state.cargo, state.general);
+	market_write_end();
+	shm_demand_expire_reservations(state.demand, state.general, state.id);
+	shm_port_market_changed(state.port, state.id);
+	shm_port_publish_day(state.general, state.port, state.id, day);
+}
+
+/**
+ * @brief Joins the pending checkpoint once every ship joined it. Called only
+ * 	between two batches of requests, or with the workers stopped.
+ */
+void join_checkpoint(void)
+{
+	if (get_checkpoint_phase(state.general) != CHECKPOINT_PORTS
+	    || get_checkpoint_day(state.general) == state.joined_day)
+		return;
+	state.joined_day = get_checkpoint_day(state.general);
+	checkpoint_join(state.general, checkpoint_port_slot(state.id), state.cargo_hold);
+}
+
+void serve_request(int ship_id, int cargo_type, int amount, int status)
+{
+	unsigned long start_ns;
+
+	stats_count(CNT_MSG_RECEIVED, 1);
+	start_ns = get_time_ns();
+	respond_ship_msg(ship_id, cargo_type, amount, status);
+	stats_record_since(LAT_PORT_RESPONSE, start_ns);
+}
+
+/**
+ * @brief Starts SO_DOCK_WORKERS dock workers, at most one per dock of the
+ * 	port since a dock serves one ship at a time. From now on the
+ * 	signals are taken by serve_signals() only.
+ * @return FALSE if no worker started, the port serves the requests itself.
+ */
+bool_t start_workers(void)
+{
+	sigset_t mask;
+	pthread_rwlockattr_t attr;
+	int i;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGDAY);
+	sigaddset(&mask, SIGSWELL);
+	sigaddset(&mask, SIGINT);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	/* The day and the swell must not wait for a pause between requests */
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&state.gate, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	cargo_list_pool_set_lock(pool_lock, pool_unlock);
+
+	state.n_workers = MIN(get_dock_workers(state.general), shm_port_get_docks(state.port, state.id));
+	state.workers = malloc(sizeof(pthread_t) * state.n_workers);
+	if (state.workers == NULL) {
+		dprintf(2, "port.c: id: %d: Failed to allocate the dock workers.\n", state.id);
+		state.n_workers = 0;
+	}
+	for (i = 0; i < state.n_workers; i++) {
+		if (pthread_create(&state.workers[i], NULL, serve_docks, NULL) != 0) {
+			dprintf(2, "port.c: id: %d: Failed to start dock worker %d.\n", state.id, i);
+			state.n_workers = i;
+			break;
 		}
-		if (msg_commerce_receive(msg_in_id, state.id, &ship_id, &needed_type, &needed_amount, NULL, &status, FALSE) == TRUE) {
-			respond_ship_msg(ship_id, needed_type, needed_amount, status);
+	}
+	if (state.n_workers > 0)
+		return TRUE;
+
+	/* Back to the serial loop, which takes the signals in their handlers */
+	cargo_list_pool_set_lock(NULL, NULL);
+	pthread_rwlock_destroy(&state.gate);
+	pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+	return FALSE;
+}
+
+/**
+ * @brief Body of a dock worker: serves the requests of the ships one at a
+ * 	time, concurrently with the other workers of the port.
+ */
+void *serve_docks(void *arg)
+{
+	int msg_in_id = msg_in_get_id(state.general, state.shard);
+	int ship_id, needed_type, needed_amount, status;
+
+	(void)arg;
+	while (1) {
+		if (msg_commerce_receive(msg_in_id, state.id, &ship_id, &needed_type, &needed_amount, NULL, &status,
+					 FALSE) == FALSE) {
+			/* The queue is removed at the end of the simulation */
+			if (errno == EINTR)
+				continue;
+			break;
 		}
+		stats_count(CNT_PORT_SYSCALLS, 1);
+		pthread_rwlock_rdlock(&state.gate);
+		serve_request(ship_id, needed_type, needed_amount, status);
+		pthread_rwlock_unlock(&state.gate);
 	}
+	return NULL;
 }
 
+/**
+ * @brief Takes the signals of a port with dock workers: the day and the
+ * 	swell stop the workers between two requests while they run.
+ */
+void serve_signals(void)
+{
+	sigset_t mask;
+	int signal;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGDAY);
+	sigaddset(&mask, SIGSWELL);
+	sigaddset(&mask, SIGINT);
+	/* A day may have started before the signals were blocked */
+	pthread_rwlock_wrlock(&state.gate);
+	start_day();
+	pthread_rwlock_unlock(&state.gate);
+	while (1) {
+		if (sigwait(&mask, &signal) != 0)
+			continue;
+		pthread_rwlock_wrlock(&state.gate);
+		switch (signal) {
+		case SIGDAY:
+			start_day();
+			join_checkpoint();
+			break;
+		case SIGSWELL:
+			swell();
+			break;
+		case SIGINT:
+			close_all();
+		}
+		pthread_rwlock_unlock(&state.gate);
+	}
+}
 
 void respond_ship_msg(int ship_id, int cargo_type, int amount, int status)
 {
-	o_list_t *cargo;
-	struct commerce_msg msg;
-	int msg_out_id = msg_out_get_id(state.general);
+	struct request req;
+
+	req.ship_id = ship_id;
+	req.cargo_type = cargo_type;
+	req.amount = amount;
+	req.status = status;
+
+	/* The lots of the type are sent in order of expiration by a single worker */
+	if (status == STATUS_BUY)
+		pthread_mutex_lock(&state.cargo_lock[cargo_type]);
+	market_write_begin();
+	apply_request(&req);
+	market_write_end();
+	reply_request(&req);
+	if (status == STATUS_BUY)
+		pthread_mutex_unlock(&state.cargo_lock[cargo_type]);
+
+	if (status == STATUS_SELL)
+		update_cargo_dumps(cargo_type, req.exchanged, 0);
+	else if (status == STATUS_BUY)
+		update_cargo_dumps(cargo_type, 0, req.exchanged);
+}
+
+/**
+ * @brief Serves the requests drained from the queue: the market is updated
+ * 	once for all of them, then the replies are sent and the dumps of the
+ * 	cargo types are updated once per type.
+ */
+void serve_batch(int n)
+{
+	struct request *req;
+	unsigned long start_ns;
+	int i, type;
+
+	start_ns = get_time_ns();
+	stats_count(CNT_MSG_RECEIVED, n);
+	market_write_begin();
+	for (i = 0; i < n; i++)
+		apply_request(&state.batch[i]);
+	market_write_end();
+
+	for (i = 0; i < n; i++) {
+		req = &state.batch[i];
+		reply_request(req);
+		if (req->status == STATUS_SELL)
+			state.batch_received[req->cargo_type] += req->exchanged;
+		else if (req->status == STATUS_BUY)
+			state.batch_shipped[req->cargo_type] += req->exchanged;
+		stats_record_since(LAT_PORT_RESPONSE, start_ns);
+	}
+
+	for (type = 0; type < get_merci(state.general); type++) {
+		if (state.batch_received[type] == 0 && state.batch_shipped[type] == 0)
+			continue;
+		update_cargo_dumps(type, state.batch_received[type], state.batch_shipped[type]);
+		state.batch_received[type] = 0;
+		state.batch_shipped[type] = 0;
+	}
+}
+
+/**
+ * @brief Updates the market row and the dumps of the port for a request,
+ * 	between market_write_begin() and market_write_end().
+ */
+void apply_request(struct request *req)
+{
 	int port_amount;
-	int quantity, expiration_date;
-
-	int exchanged_amount;
-
-	if (status == STATUS_SELL) { /* Port is buying */
-		port_amount = shm_demand_get_quantity(state.general, state.demand, state.id, cargo_type);
-		exchanged_amount = MIN(amount, port_amount);
-		shm_demand_remove_quantity(state.demand, state.general, state.id, cargo_type, exchanged_amount);
-		msg = msg_commerce_create(ship_id, state.id, cargo_type, exchanged_amount, -1, STATUS_ACCEPTED);
-		msg_commerce_send(msg_out_id, &msg);
-		shm_cargo_update_dump_received_in_port(state.cargo, cargo_type, exchanged_amount, sem_cargo_get_id(state.general));
-		shm_port_update_dump_cargo_received(state.port, state.id, exchanged_amount);
-
-	} else if (status == STATUS_BUY) { /* Port is selling */
-		port_amount = shm_offer_get_quantity(state.general, state.offer, state.id, cargo_type);
-		if (port_amount <= 0) {
-			msg = msg_commerce_create(ship_id, state.id, -1, -1, -1, STATUS_REFUSED);
-			msg_commerce_send(msg_out_id, &msg);
+
+	req->exchanged = 0;
+	if (req->status == STATUS_SELL) { /* Port is buying */
+		/* The demand reserved by the other ships is not for sale */
+		port_amount = shm_demand_get_available(state.general, state.demand, state.id, req->cargo_type)
+			+ shm_demand_get_reserved(state.general, state.demand, req->ship_id, state.id, req->cargo_type);
+		port_amount = MIN(port_amount,
+				  shm_demand_get_quantity(state.general, state.demand, state.id, req->cargo_type));
+		req->exchanged = MIN(req->amount, port_amount);
+		shm_demand_remove_quantity(state.demand, state.general, state.id, req->cargo_type, req->exchanged);
+		shm_port_update_dump_cargo_received(state.port, state.id, req->exchanged);
+	} else if (req->status == STATUS_BUY) { /* Port is selling */
+		port_amount = shm_offer_get_quantity(state.general, state.offer, state.id, req->cargo_type);
+		if (port_amount <= 0)
 			return;
-		}
-		exchanged_amount = MIN(amount, port_amount);
-		shm_offer_remove_quantity(state.offer, state.general, state.id, cargo_type, exchanged_amount);
-		shm_cargo_update_dump_available_in_port(state.cargo, cargo_type, -exchanged_amount, sem_cargo_get_id(state.general));
-		shm_port_update_dump_cargo_shipped(state.port, state.id, exchanged_amount);
-		cargo = cargo_list_pop_needed(state.cargo_hold[cargo_type], exchanged_amount);
-		while (exchanged_amount > 0) {
-			cargo_list_pop(cargo, &quantity, &expiration_date);
-			exchanged_amount -= quantity;
-			status = exchanged_amount <= 0 ? STATUS_ACCEPTED : STATUS_PARTIAL;
-			msg = msg_commerce_create(ship_id, state.id, cargo_type, quantity, expiration_date, status);
-			msg_commerce_send(msg_out_id, &msg);
-		}
+		req->exchanged = MIN(req->amount, port_amount);
+		shm_offer_remove_quantity(state.offer, state.general, state.id, req->cargo_type, req->exchanged);
+		shm_port_update_dump_cargo_shipped(state.port, state.id, req->exchanged);
 		shm_port_update_dump_cargo_available(state.general, state.port, state.offer, state.id);
-        cargo_list_delete(cargo);
-	} else {
-		msg = msg_commerce_create(ship_id, state.id, -1, -1, -1, STATUS_REFUSED);
-		msg_commerce_send(msg_out_id, &msg);
 	}
 }
 
+/**
+ * @brief Sends the reply to a request applied by apply_request(), the lots
+ * 	sold are taken from the hold and packed MSG_LOTS per message.
+ */
+void reply_request(struct request *req)
+{
+	struct lot_reply reply;
+	struct commerce_msg msg;
+	int msg_out_id = msg_out_get_id(state.general, state.shard);
+
+	if (req->status == STATUS_SELL) {
+		msg = msg_commerce_create(req->ship_id, state.id, req->cargo_type, req->exchanged, -1, STATUS_ACCEPTED);
+		send_reply(msg_out_id, &msg);
+		if (req->exchanged > 0)
+			stats_count(CNT_TRADES, 1);
+		return;
+	}
+	if (req->status == STATUS_BUY && req->exchanged > 0) {
+		stats_count(CNT_TRADES, 1);
+		reply.msg_out_id = msg_out_id;
+		reply.msg = msg_commerce_create(req->ship_id, state.id, req->cargo_type, 0, -1, STATUS_PARTIAL);
+		if (cargo_list_consume(state.cargo_hold[req->cargo_type], req->exchanged, send_lot, &reply) > 0)
+			return;
+	}
+	msg = msg_commerce_create(req->ship_id, state.id, -1, -1, -1, STATUS_REFUSED);
+	send_reply(msg_out_id, &msg);
+}
+
+/**
+ * @brief Updates the cargo dumps for the lots received and shipped by the port.
+ */
+void update_cargo_dumps(int cargo_type, int received, int shipped)
+{
+	shm_cargo_update_dump_port_trade(state.cargo, cargo_type, received, shipped, sem_cargo_get_id(state.general));
+	stats_count(CNT_PORT_SYSCALLS, 2);
+}
+
+void send_reply(int msg_out_id, struct commerce_msg *msg)
+{
+	msg_commerce_send(msg_out_id, msg);
+	stats_count(CNT_MSG_SENT, 1);
+	stats_count(CNT_PORT_SYSCALLS, 1);
+}
+
+/**
+ * @brief Counts in the statistics of the port, shared by its dock workers.
+ */
+void stats_count(enum counter type, unsigned long value)
+{
+	pthread_mutex_lock(&state.stats_lock);
+	shm_stats_count(state.stats, state.stats_slot, type, value);
+	pthread_mutex_unlock(&state.stats_lock);
+}
+
+void stats_record_since(enum latency type, unsigned long start_ns)
+{
+	pthread_mutex_lock(&state.stats_lock);
+	shm_stats_record_since(state.stats, state.stats_slot, type, start_ns);
+	pthread_mutex_unlock(&state.stats_lock);
+}
+
+void pool_lock(void)
+{
+	pthread_mutex_lock(&state.pool_lock);
+}
+
+void pool_unlock(void)
+{
+	pthread_mutex_unlock(&state.pool_lock);
+}
+
+/**
+ * @brief Sends one lot to the ship, the last one closes the transaction.
+ */
+void send_lot(int quantity, int expire, bool_t last, void *arg)
+{
+	struct lot_reply *reply = arg;
+
+	if (msg_commerce_add_lot(&reply->msg, quantity, expire) == FALSE && !last)
+		return;
+	reply->msg.status = last ? STATUS_ACCEPTED : STATUS_PARTIAL;
+	send_reply(reply->msg_out_id, &reply->msg);
+	reply->msg.n_lots = 0;
+	reply->msg.quantity = 0;
+}
+
 void generate_coordinates(void)
 {
 	struct coord coordinates;
@@ -176,7 +554,58 @@ void generate_coordinates(void)
 		break;
 	}
 
+	market_write_begin();
 	shm_port_set_coordinates(state.port, state.id, coordinates);
+	market_write_end();
+}
+
+/**
+ * @brief Starts an update of the coordinates or of the market row of the port,
+ * 	a swell must not put the port to sleep while readers wait for the end.
+ */
+void market_write_begin(void)
+{
+	sigset_t mask;
+
+	/* With dock workers the signals are blocked, see serve_signals() */
+	if (state.n_workers == 0) {
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGSWELL);
+		sigprocmask(SIG_BLOCK, &mask, NULL);
+	}
+	pthread_mutex_lock(&state.market_lock);
+	shm_port_write_begin(state.port, state.id);
+	if (state.n_workers == 0)
+		stats_count(CNT_PORT_SYSCALLS, 2);
+}
+
+void market_write_end(void)
+{
+	sigset_t mask;
+
+	shm_port_write_end(state.port, state.id);
+	pthread_mutex_unlock(&state.market_lock);
+	if (state.n_workers == 0) {
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGSWELL);
+		sigprocmask(SIG_UNBLOCK, &mask, NULL);
+	}
+}
+
+/**
+ * @brief Loads the hold saved in the snapshot, saved at the same barrier as
+ * 	the offer so that they match.
+ */
+void restore_hold(void)
+{
+	/* The master stops the simulation rather than running a port with an empty hold */
+	if (checkpoint_restore_hold(state.general, checkpoint_port_slot(state.id), state.cargo_hold) == FALSE) {
+		dprintf(2, "port.c: id: %d: Failed to restore the hold.\n", state.id);
+		kill(getppid(), SIGINT);
+		exit(EXIT_FAILURE);
+	}
+	/* The day of the snapshot is started again by loop() */
+	state.current_day = get_restore_day(state.general) - 1;
 }
 
 void signal_handler_init(void)
@@ -198,9 +627,7 @@ void signal_handler(int signal)
 	case SIGDAY:
 		break;
 	case SIGSWELL:
-		shm_port_set_is_in_swell(state.port, state.id, TRUE);
-		convert_and_sleep(get_swell_duration(state.general) / 24.0);
-		shm_port_set_is_in_swell(state.port, state.id, FALSE);
+		swell();
 		break;
 	case SIGSEGV:
 		dprintf(1, "port.c: id: %d: Received SIGSEGV signal.\n", state.id);
@@ -211,18 +638,35 @@ void signal_handler(int signal)
 	}
 }
 
+/**
+ * @brief The port stops serving the ships for the duration of the swell.
+ */
+void swell(void)
+{
+	shm_port_set_is_in_swell(state.port, state.id, TRUE);
+	convert_and_sleep(get_swell_duration(state.general) / 24.0);
+	shm_port_set_is_in_swell(state.port, state.id, FALSE);
+}
+
 void close_all(void)
 {
 	int i;
 
+	/* Dock workers, if any, are stopped out of a request by serve_signals() */
 	for (i = 0; i < get_merci(state.general); i++) {
 		cargo_list_delete(state.cargo_hold[i]);
 	}
 	free(state.cargo_hold);
+	free(state.cargo_lock);
+	free(state.batch_received);
+	free(state.batch_shipped);
+	free(state.workers);
+	cargo_list_pool_destroy();
 	shm_port_detach(state.port);
 	shm_cargo_detach(state.cargo);
 	shm_offer_detach(state.offer);
 	shm_demand_detach(state.demand);
+	shm_stats_detach(state.stats);
 	shm_general_detach(state.general);
 	exit(EXIT_SUCCESS);
 }
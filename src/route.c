@@ -0,0 +1,473 @@
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "include/utils.h"
+#include "include/shm_general.h"
+#include "include/shm_port.h"
+#include "include/shm_cargo.h"
+#include "include/shm_offer_demand.h"
+#include "include/cargo_list.h"
+#include "include/route.h"
+
+#define ROUTE_BEAM 4		/* first hops expanded into a second one */
+#define ROUTE_BUDGET 65536	/* port x cargo evaluations per call after the first hop */
+#define ROUTE_DAYS 16		/* arrival days whose not expired quantities are memoized */
+#define ROUTE_CACHE 64
+
+/**
+ * @brief A first hop of a route.
+ */
+struct hop {
+	int port;
+	double time;	/* travel time in days */
+	int sold;	/* quantity sold at the port */
+	int value;	/* quantity sold along the whole route */
+	double total_time;
+};
+
+struct route_cache_entry {
+	int port, day;
+	unsigned long mix;
+	int next;
+};
+
+/**
+ * @brief Scratch and cache of the planner, one per ship process.
+ */
+static struct {
+	int n_merci;
+	int *not_expired;	/* [ROUTE_DAYS][n_merci], by arrival day */
+	bool_t valid[ROUTE_DAYS];
+	int *sold;		/* by cargo type, at the first hop being expanded */
+	int *offer;		/* by cargo type, of the first hop being expanded */
+	int n_words;
+	unsigned long *candidates;	/* port set of the first hop */
+	unsigned long *next;		/* port set of the second hop being expanded */
+	int *port_shard;		/* region of every port, see route_get_shard() */
+	unsigned long *nearby;		/* [get_regions()][n_words], ports in or next to a region */
+	struct route_cache_entry cache[ROUTE_CACHE];
+} planner;
+
+static bool_t route_planner_init(shm_general_t *g, shm_port_t *p);
+static int route_count_ports(const unsigned long *set);
+static void route_mask_region(shm_general_t *g, unsigned long *set, int shard);
+static int route_candidates(shm_general_t *g, shm_offer_t *o, shm_demand_t *d, o_list_t **cargo_hold,
+			    int free_tons, int shard);
+static int route_not_expired(shm_general_t *g, o_list_t **cargo_hold, int type, double time);
+static unsigned long route_hold_mix(shm_general_t *g, o_list_t **cargo_hold, int free_tons);
+static int route_sale(shm_general_t *g, shm_port_t *p, shm_demand_t *d, o_list_t **cargo_hold,
+		      int port, double time, int *sold);
+static void route_second_hop(shm_general_t *g, shm_port_t *p, shm_offer_t *o, shm_demand_t *d, shm_cargo_t *c,
+			     o_list_t **cargo_hold, int free_tons, struct hop *first);
+static void route_beam_insert(struct hop *beam, int *n_beam, struct hop hop);
+
+double route_get_travel_time(shm_general_t *g, struct coord from, struct coord to)
+{
+	double dx = to.x - from.x, dy = to.y - from.y;
+
+	return sqrt(dx * dx + dy * dy) * get_inv_speed(g);
+}
+
+int route_get_shard(shm_general_t *g, struct coord position)
+{
+	int shards = get_shards(g), x, y;
+
+	if (shards == 0)
+		return 0;
+	x = (int)(position.x * shards / get_lato(g));
+	y = (int)(position.y * shards / get_lato(g));
+	/* The right and top edges belong to the last regions */
+	x = MAX(MIN(x, shards - 1), 0);
+	y = MAX(MIN(y, shards - 1), 0);
+	return y * shards + x;
+}
+
+int route_find_best_port(shm_general_t *g, shm_port_t *p, shm_demand_t *d,
+			 o_list_t **cargo_hold, struct coord position, int curr_port_id)
+{
+	int i, cargo_type;
+	int port, best_port = -1;
+	int n_ports, n_row;
+	int port_demand;
+	int sale_amount, sale_best_amount = 0;
+	int amount_not_expired;
+	unsigned int seq;
+	double time_required, best_time;
+
+	n_ports = get_porti(g);
+	n_row = get_port_types(g);
+	for (port = 0; port < n_ports; port++) {
+		if (port == curr_port_id) continue;
+
+		/* Check port distance and the queue at its docks */
+		time_required = route_get_travel_time(g, position, shm_port_get_coordinates(p, port));
+		time_required += shm_port_get_expected_wait(p, port, time_required);
+
+		do {
+			seq = shm_port_read_begin(p, port);
+			sale_amount = 0;
+			for (i = 0; i < n_row; i++) {
+				cargo_type = shm_demand_get_row_type(g, d, port, i);
+				amount_not_expired = cargo_list_get_not_expired_by_day(cargo_hold[cargo_type], get_current_day(g) + (int) time_required);
+				port_demand = shm_demand_get_row_available(g, d, port, i);
+				sale_amount += MIN(amount_not_expired, port_demand);
+			}
+		} while (shm_port_read_retry(p, port, seq));
+
+		if (best_port == -1 || sale_amount > sale_best_amount
+		    || (sale_best_amount == sale_amount && time_required < best_time)) {
+			best_port = port;
+			sale_best_amount = sale_amount;
+			best_time = time_required;
+		}
+	}
+	return best_port;
+}
+
+int route_plan(shm_general_t *g, shm_port_t *p, shm_offer_t *o, shm_demand_t *d, shm_cargo_t *c,
+	       o_list_t **cargo_hold, int free_tons, struct coord position, int curr_port_id)
+{
+	struct hop beam[ROUTE_BEAM], hop, *best;
+	struct route_cache_entry *entry;
+	int i, w, n_beam, budget;
+	unsigned long mix, bits;
+
+	if (!route_planner_init(g, p))
+		return route_find_best_port(g, p, d, cargo_hold, position, curr_port_id);
+
+	mix = route_hold_mix(g, cargo_hold, free_tons);
+	entry = &planner.cache[(mix ^ (unsigned long)curr_port_id * 2654435761UL) % ROUTE_CACHE];
+	if (entry->port == curr_port_id && entry->day == get_current_day(g) && entry->mix == mix)
+		return entry->next;
+
+	/* First hop: the candidate ports, scored like route_find_best_port() */
+	route_candidates(g, o, d, cargo_hold, free_tons, route_get_shard(g, position));
+	n_beam = 0;
+	for (w = 0; w < planner.n_words; w++) {
+		for (bits = planner.candidates[w]; bits != 0; bits &= bits - 1) {
+			hop.port = w * PORT_SET_BITS + __builtin_ctzl(bits);
+			if (hop.port == curr_port_id) continue;
+			hop.time = route_get_travel_time(g, position, shm_port_get_coordinates(p, hop.port));
+			hop.time += shm_port_get_expected_wait(p, hop.port, hop.time);
+			hop.sold = route_sale(g, p, d, cargo_hold, hop.port, hop.time, NULL);
+			hop.value = hop.sold;
+			hop.total_time = hop.time;
+			route_beam_insert(beam, &n_beam, hop);
+		}
+	}
+	if (n_beam == 0)
+		return -1;
+
+	/* Second hop from the most promising ones, charged the ports each one scored */
+	for (i = 0, budget = ROUTE_BUDGET; i < n_beam && budget > 0; i++) {
+		route_second_hop(g, p, o, d, c, cargo_hold, free_tons, &beam[i]);
+		budget -= route_count_ports(planner.next) * get_port_types(g);
+	}
+
+	best = &beam[0];
+	for (i = 1; i < n_beam; i++)
+		if (beam[i].value > best->value
+		    || (beam[i].value == best->value && beam[i].total_time < best->total_time))
+			best = &beam[i];
+
+	entry->port = curr_port_id;
+	entry->day = get_current_day(g);
+	entry->mix = mix;
+	entry->next = best->port;
+	return best->port;
+}
+
+void route_plan_destroy(void)
+{
+	free(planner.not_expired);
+	free(planner.sold);
+	free(planner.offer);
+	free(planner.candidates);
+	free(planner.next);
+	free(planner.port_shard);
+	free(planner.nearby);
+	planner.not_expired = NULL;
+	planner.sold = NULL;
+	planner.offer = NULL;
+	planner.candidates = NULL;
+	planner.next = NULL;
+	planner.port_shard = NULL;
+	planner.nearby = NULL;
+	planner.n_merci = 0;
+}
+
+static bool_t route_planner_init(shm_general_t *g, shm_port_t *p)
+{
+	int i, r, n_merci = get_merci(g), shards = get_shards(g);
+	int *shard;
+
+	if (planner.n_merci == n_merci)
+		return TRUE;
+	route_plan_destroy();
+	planner.n_words = shm_offer_demand_get_set_words(g);
+	planner.not_expired = malloc(sizeof(int) * ROUTE_DAYS * n_merci);
+	planner.sold = malloc(sizeof(int) * n_merci);
+	planner.offer = malloc(sizeof(int) * n_merci);
+	planner.candidates = malloc(sizeof(unsigned long) * planner.n_words);
+	planner.next = malloc(sizeof(unsigned long) * planner.n_words);
+	planner.port_shard = malloc(sizeof(int) * get_porti(g));
+	planner.nearby = calloc(get_regions(g) * planner.n_words, sizeof(unsigned long));
+	if (planner.not_expired == NULL || planner.sold == NULL || planner.offer == NULL
+	    || planner.candidates == NULL || planner.next == NULL
+	    || planner.port_shard == NULL || planner.nearby == NULL) {
+		route_plan_destroy();
+		return FALSE;
+	}
+	/* Ports never move: a port is near the regions around its own */
+	for (i = 0; i < get_porti(g); i++) {
+		shard = &planner.port_shard[i];
+		*shard = route_get_shard(g, shm_port_get_coordinates(p, i));
+		for (r = 0; r < get_regions(g); r++)
+			if (shards == 0 || (abs(r % shards - *shard % shards) <= 1
+					    && abs(r / shards - *shard / shards) <= 1))
+				planner.nearby[r * planner.n_words + i / PORT_SET_BITS] |= 1UL << i % PORT_SET_BITS;
+	}
+	planner.n_merci = n_merci;
+	for (i = 0; i < ROUTE_CACHE; i++)
+		planner.cache[i].port = -1;
+	return TRUE;
+}
+
+/**
+ * @brief Quantity of a cargo type of the hold still valid after time days,
+ * 	memoized by arrival day for the current call.
+ */
+static int route_not_expired(shm_general_t *g, o_list_t **cargo_hold, int type, double time)
+{
+	int k = (int)time, i;
+
+	if (k >= ROUTE_DAYS)
+		return cargo_list_get_not_expired_by_day(cargo_hold[type], get_current_day(g) + k);
+	if (!planner.valid[k]) {
+		for (i = 0; i < planner.n_merci; i++)
+			planner.not_expired[k * planner.n_merci + i] =
+				cargo_list_get_not_expired_by_day(cargo_hold[i], get_current_day(g) + k);
+		planner.valid[k] = TRUE;
+	}
+	return planner.not_expired[k * planner.n_merci + type];
+}
+
+/**
+ * @brief Hashes what the ship carries today and its free capacity (FNV-1a),
+ * 	resetting the memoized quantities of the previous call.
+ */
+static unsigned long route_hold_mix(shm_general_t *g, o_list_t **cargo_hold, int free_tons)
+{
+	unsigned long hash = 2166136261UL;
+	int i;
+
+	for (i = 0; i < ROUTE_DAYS; i++)
+		planner.valid[i] = FALSE;
+	for (i = 0; i < planner.n_merci; i++)
+		hash = (hash ^ (unsigned long)route_not_expired(g, cargo_hold, i, 0)) * 16777619UL;
+	return (hash ^ (unsigned long)free_tons) * 16777619UL;
+}
+
+static int route_count_ports(const unsigned long *set)
+{
+	int w, n = 0;
+
+	for (w = 0; w < planner.n_words; w++)
+		n += __builtin_popcountl(set[w]);
+	return n;
+}
+
+/**
+ * @brief Keeps in a port set only the ports in or next to a region, if the
+ * 	map is split in regions.
+ */
+static void route_mask_region(shm_general_t *g, unsigned long *set, int shard)
+{
+	int w;
+
+	if (get_shards(g) == 0)
+		return;
+	for (w = 0; w < planner.n_words; w++)
+		set[w] &= planner.nearby[shard * planner.n_words + w];
+}
+
+/**
+ * @brief Fills planner.candidates with the ports worth scoring: the ones that
+ * 	demand a type of the hold and, if they are too few to fill the beam and
+ * 	the ship has room, the ones that offer any type. With SO_SHARDS only the
+ * 	ports near the region of the ship are seen. Every port is a candidate
+ * 	if none is.
+ * @return The number of candidates.
+ */
+static int route_candidates(shm_general_t *g, shm_offer_t *o, shm_demand_t *d, o_list_t **cargo_hold,
+			    int free_tons, int shard)
+{
+	int type, w, n_candidates;
+	const unsigned long *set;
+
+	for (w = 0; w < planner.n_words; w++)
+		planner.candidates[w] = 0;
+	for (type = 0; type < planner.n_merci; type++) {
+		if (route_not_expired(g, cargo_hold, type, 0) <= 0) continue;
+		set = shm_demand_get_port_set(g, d, type);
+		for (w = 0; w < planner.n_words; w++)
+			planner.candidates[w] |= set[w];
+	}
+	route_mask_region(g, planner.candidates, shard);
+	n_candidates = route_count_ports(planner.candidates);
+	if (n_candidates <= ROUTE_BEAM && free_tons > 0) {
+		for (type = 0; type < planner.n_merci; type++) {
+			set = shm_offer_get_port_set(g, o, type);
+			for (w = 0; w < planner.n_words; w++)
+				planner.candidates[w] |= set[w];
+		}
+		route_mask_region(g, planner.candidates, shard);
+		n_candidates = route_count_ports(planner.candidates);
+	}
+	if (n_candidates > 0)
+		return n_candidates;
+
+	for (w = 0; w < planner.n_words; w++)
+		planner.candidates[w] = ~0UL;
+	if (get_porti(g) % PORT_SET_BITS != 0)
+		planner.candidates[planner.n_words - 1] = (1UL << get_porti(g) % PORT_SET_BITS) - 1;
+	return get_porti(g);
+}
+
+/**
+ * @brief Quantity the hold sells at a port reached after time days, on a
+ * 	consistent snapshot of the demand of the port.
+ * @param sold If not NULL, filled with the quantity sold by cargo type, only
+ * 	for the types of the port.
+ */
+static int route_sale(shm_general_t *g, shm_port_t *p, shm_demand_t *d, o_list_t **cargo_hold,
+		      int port, double time, int *sold)
+{
+	int i, type, amount, total;
+	unsigned int seq;
+
+	do {
+		seq = shm_port_read_begin(p, port);
+		total = 0;
+		for (i = 0; i < get_port_types(g); i++) {
+			amount = shm_demand_get_row_available(g, d, port, i);
+			if (amount <= 0 && sold == NULL) continue;
+			type = shm_demand_get_row_type(g, d, port, i);
+			amount = MIN(MAX(route_not_expired(g, cargo_hold, type, time), 0), amount);
+			if (sold != NULL)
+				sold[type] = amount;
+			total += amount;
+		}
+	} while (shm_port_read_retry(p, port, seq));
+	return total;
+}
+
+/**
+ * @brief Adds to the first hop the best port to sail to next: what is left
+ * 	in the hold plus what the ship can buy at the first port, filling the
+ * 	capacity freed by the sale, for the demand of the second one.
+ */
+static void route_second_hop(shm_general_t *g, shm_port_t *p, shm_offer_t *o, shm_demand_t *d, shm_cargo_t *c,
+			     o_list_t **cargo_hold, int free_tons, struct hop *first)
+{
+	int i, w, port, type, n_row, left, demand, amount, bought, free_left, value, best_value = 0;
+	unsigned int seq;
+	unsigned long bits;
+	const unsigned long *set;
+	double time, leg, best_time = 0;
+	struct coord from;
+
+	n_row = get_port_types(g);
+	/* Only the types of the first port are sold or bought there */
+	for (type = 0; type < planner.n_merci; type++) {
+		planner.sold[type] = 0;
+		planner.offer[type] = 0;
+	}
+	do {
+		seq = shm_port_read_begin(p, first->port);
+		route_sale(g, p, d, cargo_hold, first->port, first->time, planner.sold);
+		for (i = 0; i < n_row; i++)
+			planner.offer[shm_offer_get_row_type(g, o, first->port, i)] =
+				shm_offer_get_row_quantity(g, o, first->port, i);
+	} while (shm_port_read_retry(p, first->port, seq));
+	for (i = 0; i < n_row; i++) {
+		type = shm_offer_get_row_type(g, o, first->port, i);
+		free_tons += planner.sold[type] * shm_cargo_get_size(c, type);
+	}
+
+	/* Only the ports that demand what is left or what can be bought */
+	for (w = 0; w < planner.n_words; w++)
+		planner.next[w] = 0;
+	for (type = 0; type < planner.n_merci; type++) {
+		if (planner.offer[type] <= 0
+		    && route_not_expired(g, cargo_hold, type, first->time) <= planner.sold[type])
+			continue;
+		set = shm_demand_get_port_set(g, d, type);
+		for (w = 0; w < planner.n_words; w++)
+			planner.next[w] |= set[w];
+	}
+	route_mask_region(g, planner.next, planner.port_shard[first->port]);
+
+	from = shm_port_get_coordinates(p, first->port);
+	for (w = 0; w < planner.n_words; w++) {
+		for (bits = planner.next[w]; bits != 0; bits &= bits - 1) {
+			port = w * PORT_SET_BITS + __builtin_ctzl(bits);
+			if (port == first->port) continue;
+			leg = route_get_travel_time(g, from, shm_port_get_coordinates(p, port));
+			time = first->time + leg;
+			time += shm_port_get_expected_wait(p, port, time);
+
+			do {
+				seq = shm_port_read_begin(p, port);
+				value = 0;
+				free_left = free_tons;
+				for (i = 0; i < n_row; i++) {
+					demand = shm_demand_get_row_available(g, d, port, i);
+					if (demand <= 0) continue;
+					type = shm_demand_get_row_type(g, d, port, i);
+					left = route_not_expired(g, cargo_hold, type, time) - planner.sold[type];
+					amount = MIN(MAX(left, 0), demand);
+					/* Lots bought at the first port must survive the leg */
+					if (amount < demand && free_left > 0 && shm_cargo_get_life(c, type) > leg) {
+						bought = MIN(planner.offer[type], demand - amount);
+						bought = MIN(bought, free_left / shm_cargo_get_size(c, type));
+						free_left -= bought * shm_cargo_get_size(c, type);
+						amount += bought;
+					}
+					value += amount;
+				}
+			} while (shm_port_read_retry(p, port, seq));
+
+			if (value > best_value || (value == best_value && value > 0 && time < best_time)) {
+				best_value = value;
+				best_time = time;
+			}
+		}
+	}
+	first->value = first->sold + best_value;
+	if (best_value > 0)
+		first->total_time = best_time;
+}
+
+/**
+ * @brief Keeps the ROUTE_BEAM first hops that sell the most, the closest on ties.
+ */
+static void route_beam_insert(struct hop *beam, int *n_beam, struct hop hop)
+{
+	int i;
+
+	for (i = *n_beam; i > 0; i--) {
+		if (beam[i - 1].sold > hop.sold
+		    || (beam[i - 1].sold == hop.sold && beam[i - 1].time <= hop.time))
+			break;
+		if (i < ROUTE_BEAM)
+			beam[i] = beam[i - 1];
+	}
+	if (i < ROUTE_BEAM) {
+		beam[i] = hop;
+		if (*n_beam < ROUTE_BEAM)
+			(*n_beam)++;
+	}
+}
@@ -4,7 +4,6 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 #include <time.h>
 #include <signal.h>
 
@@ -19,20 +18,33 @@
 #include "include/shm_offer_demand.h"
 #include "include/cargo_list.h"
 #include "include/msg_commerce.h"
-
-#define GET_DISTANCE(dest)\
-	(sqrt(pow(dest.x - shm_ship_get_coords(state.ship, state.id).x, 2) + pow(dest.y - shm_ship_get_coords(state.ship, state.id).y, 2)))
+#include "include/shm_stats.h"
+#include "include/route.h"
+#include "include/checkpoint.h"
 
 void signal_handler(int signal);
 
 void init_location(void);
+void restore_hold(void);
+
 int pick_first_destination_port(void);
 void trade(void);
+int get_amount_to_sell(int cargo_type);
 int sell(int cargo_type);
+int sell_all(void);
+int receive_sold(int *tons_sold);
+int buy_all(void);
+int receive_bought(int *tons_bought);
+void commit_reservation(void);
 int ship_sell(int amount_to_sell, int cargo_type);
 int buy(int cargo_type);
 int ship_buy(int cargo_type, int amount_to_buy, int expiration_date);
+int receive_lots(struct commerce_msg *msg);
+void remove_expired(void);
 void move(int port_id);
+void reserve_demand(int port_id, double time_required);
+
+void join_checkpoint(void);
 
 void close_all(void);
 void loop(void);
@@ -48,8 +60,16 @@ struct state {
 	shm_demand_t *demand;
 	shm_offer_t *offer;
 	o_list_t **cargo_hold;
+	int *reservation;	/* by cargo type, see reserve_demand() */
+	shm_stats_t *stats;
+	int stats_slot;
 
 	int curr_port_id;
+	int shard;		/* region the ship is in or sailing to, see route_get_shard() */
+	int queued_port;	/* port whose queue counts the ship, -1 if none */
+	int next_expire;	/* oldest expiration date in the hold, see remove_expired() */
+	volatile sig_atomic_t checkpoint_asked;	/* set by SIGDAY, see join_checkpoint() */
+	int joined_day;		/* day of the last checkpoint joined */
 };
 
 struct state state;
@@ -67,24 +87,38 @@ int main(int argc, char *argv[])
 	sa.sa_mask = mask;
 	sigaction(SIGINT, &sa, NULL);
 	sigaction(SIGSEGV, &sa, NULL);
+	sigaction(SIGDAY, &sa, NULL);
 
 	state.id = (int)strtol(argv[1], NULL, 10);
+	state.queued_port = -1;
+	state.next_expire = -1;
+	state.joined_day = -1;
+	ipc_set_namespace((int)strtol(argv[2], NULL, 10));
 	shm_general_attach(&state.general);
 	state.port = shm_port_attach(state.general);
 	state.ship = shm_ship_attach(state.general);
 	state.cargo = shm_cargo_attach(state.general);
 	state.demand = shm_demand_attach(state.general);
 	state.offer = shm_offer_attach(state.general);
+	state.stats = shm_stats_attach(state.general);
+	state.stats_slot = shm_stats_ship_slot(state.general, state.id);
 
 	state.cargo_hold = malloc(sizeof(state.cargo_hold) * get_merci(state.general));
 	for (i = 0; i < get_merci(state.general); i++) {
 		state.cargo_hold[i] = cargo_list_create();
 	}
+	state.reservation = malloc(sizeof(int) * get_merci(state.general));
 
 	srand(time(NULL) * getpid());
-	init_location();
+	if (get_restore_day(state.general) >= 0)
+		restore_hold();
+	else
+		init_location();
+	state.shard = route_get_shard(state.general, shm_ship_get_coords(state.ship, state.id));
 
+	/* A storm or a maelstrom never starts a checkpoint */
 	sigemptyset(&mask);
+	sigaddset(&mask, SIGDAY);
 	sa.sa_mask = mask;
 	sigaction(SIGSTORM, &sa, NULL);
 	sigaction(SIGMAELSTROM, &sa, NULL);
@@ -98,10 +132,14 @@ void loop(void)
 {
 	int id_dest_port;
 
-	id_dest_port = pick_first_destination_port();
-	move(id_dest_port);
-	trade();
+	/* A restored ship starts from its position as if it just left a port */
+	if (get_restore_day(state.general) < 0) {
+		id_dest_port = pick_first_destination_port();
+		move(id_dest_port);
+		trade();
+	}
 	while (1) {
+		join_checkpoint();
 		id_dest_port = find_new_destination_port();
 		move(id_dest_port);
 		trade();
@@ -122,6 +160,30 @@ void init_location(void)
 	shm_ship_set_is_moving(state.ship, state.id, TRUE);
 }
 
+/**
+ * @brief Loads the hold saved in the snapshot, the ship restarts at sea
+ * 	and its capacity is computed again from the hold.
+ */
+void restore_hold(void)
+{
+	int type, tons;
+
+	state.curr_port_id = -1;
+	if (checkpoint_restore_hold(state.general, checkpoint_ship_slot(state.general, state.id),
+				    state.cargo_hold) == FALSE) {
+		dprintf(2, "ship.c: id: %d: Failed to restore the hold.\n", state.id);
+		kill(getppid(), SIGINT);
+		exit(EXIT_FAILURE);
+	}
+	tons = 0;
+	for (type = 0; type < get_merci(state.general); type++)
+		tons += cargo_list_get_quantity(state.cargo_hold[type]) * shm_cargo_get_size(state.cargo, type);
+	shm_ship_update_capacity(state.ship, state.id,
+				 get_capacity(state.general) - tons - shm_ship_get_capacity(state.ship, state.id));
+	shm_ship_set_is_at_dock(state.ship, state.id, FALSE);
+	shm_ship_set_is_moving(state.ship, state.id, TRUE);
+}
+
 int pick_first_destination_port(void)
 {
 	int target_port;
@@ -139,125 +201,253 @@ void move(int port_id)
 
 	dest_coords = shm_port_get_coordinates(state.port, port_id);
 	shm_ship_set_is_moving(state.ship, state.id, TRUE);
+	/* From now on the ship trades through the queues of the destination */
+	state.shard = route_get_shard(state.general, dest_coords);
 	/* calculate time required to arrive (in days) */
-	time_required = GET_DISTANCE(dest_coords) / get_speed(state.general);
-	convert_and_sleep(time_required);
+	time_required = route_get_travel_time(state.general, shm_ship_get_coords(state.ship, state.id), dest_coords);
+	reserve_demand(port_id, time_required);
+	convert_and_sleep_interruptible(time_required, join_checkpoint);
 	/* set new location */
 	shm_ship_set_coords(state.ship, state.id, dest_coords);
 	shm_ship_set_is_moving(state.ship, state.id, FALSE);
 	state.curr_port_id = port_id;
 }
 
-int find_new_destination_port(void)
+/**
+ * @brief Reserves at the destination the demand that the hold will sell
+ * 	there, so the ships leaving later do not plan on it.
+ */
+void reserve_demand(int port_id, double time_required)
 {
-	int cargo_type;
-	int port, best_port = -1;
-	int n_ports;
-	int port_demand;
-	int sale_amount, sale_best_amount = 0;
-	int amount_not_expired;
-	double time_required, best_time;
-
-	n_ports = get_porti(state.general);
-	for (port = 0; port < n_ports; port++) {
-		if (port == state.curr_port_id) continue;
-
-		/* Check port distance */
-		time_required = GET_DISTANCE(shm_port_get_coordinates(state.port, port)) / get_speed(state.general);
-
-		sale_amount = 0;
-		for (cargo_type = 0; cargo_type < get_merci(state.general); cargo_type++) {
-			amount_not_expired = cargo_list_get_not_expired_by_day(state.cargo_hold[cargo_type], get_current_day(state.general) + (int) time_required);
-			port_demand = shm_demand_get_quantity(state.general, state.demand, port, cargo_type);
-			sale_amount += MIN(amount_not_expired, port_demand);
-		}
-
-		if (best_port == -1 || sale_amount > sale_best_amount
-		    || (sale_best_amount == sale_amount && time_required < best_time)) {
-			best_port = port;
-			sale_best_amount = sale_amount;
-			best_time = time_required;
-		}
+	int i, type, arrival_day, released;
+	sigset_t mask, old_mask;
+
+	arrival_day = get_current_day(state.general) + (int)time_required;
+	for (i = 0; i < get_port_types(state.general); i++) {
+		type = shm_demand_get_row_type(state.general, state.demand, port_id, i);
+		state.reservation[type] = MIN(cargo_list_get_not_expired_by_day(state.cargo_hold[type], arrival_day),
+					      shm_demand_get_row_available(state.general, state.demand, port_id, i));
 	}
-	return best_port;
+
+	/* The handlers release the reservation too, see close_all() */
+	sigfillset(&mask);
+	sigprocmask(SIG_BLOCK, &mask, &old_mask);
+	released = shm_demand_commit(state.demand, state.general, state.id);
+	if (released >= 0)
+		shm_port_market_changed(state.port, released);
+	shm_demand_reserve(state.demand, state.general, state.id, port_id, state.reservation,
+			   arrival_day + RESERVATION_TTL);
+	shm_port_market_changed(state.port, port_id);
+	sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+int find_new_destination_port(void)
+{
+	return route_plan(state.general, state.port, state.offer, state.demand, state.cargo, state.cargo_hold,
+			  shm_ship_get_capacity(state.ship, state.id),
+			  shm_ship_get_coords(state.ship, state.id), state.curr_port_id);
 }
 
 void trade(void)
 {
-	int i, n_cargo, cargo_type, sem_docks_id;
+	int i, n_row, first, cargo_type, sem_docks_id;
 	int load_speed, tons_moved;
+	unsigned long start_ns, dock_ns;
 	sigset_t mask;
 	load_speed = get_load_speed(state.general);
-	n_cargo = get_merci(state.general);
+	n_row = get_port_types(state.general);
 
 	sem_docks_id = shm_port_get_sem_docks_id(state.port);
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGMAELSTROM);
+	sigaddset(&mask, SIGDAY);
+
+	/* The market of the port must be at most SO_DAY_LAG days old */
+	shm_port_wait_day(state.general, state.port, state.curr_port_id);
 
 	/* Requesting dock */
-	sem_execute_semop(sem_docks_id, state.curr_port_id, -1, SEM_UNDO);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	shm_port_enter_queue(state.port, state.curr_port_id);
+	state.queued_port = state.curr_port_id;
+	sigprocmask(SIG_UNBLOCK, &mask, NULL);
+	start_ns = get_time_ns();
+	/* The ship at the dock may be waiting for the others to join a checkpoint */
+	while (sem_execute_semop_interruptible(sem_docks_id, state.curr_port_id, -1, SEM_UNDO) == -1)
+		join_checkpoint();
+	dock_ns = get_time_ns();
+	shm_stats_record_since(state.stats, state.stats_slot, LAT_DOCK_WAIT, start_ns);
 	shm_ship_set_is_at_dock(state.ship, state.id, TRUE);
 
-	/* Selling */
-	if (shm_ship_get_capacity(state.ship, state.id) < get_capacity(state.general)) {
-		for (i = 0; i < n_cargo; i++) {
-			shm_ship_remove_expired(state.general, state.ship, state.cargo, state.cargo_hold, state.id);
-			sigprocmask(SIG_BLOCK, &mask, NULL);
-			tons_moved = sell(i);
-			sigprocmask(SIG_UNBLOCK, &mask, NULL);
-			if (tons_moved > 0)
-				convert_and_sleep(tons_moved / (double)load_speed);
-		}
-	}
+	if (shm_ship_get_capacity(state.ship, state.id) < get_capacity(state.general))
+		shm_stats_count(state.stats, state.stats_slot, CNT_VOYAGES, 1);
 
-	/* Buying */
-	cargo_type = RANDOM_INTEGER(0, n_cargo -1);
-	for (i = 0; i < n_cargo; i++) {
-		if (shm_ship_get_capacity(state.ship, state.id) <= 0) break;
-		shm_ship_remove_expired(state.general, state.ship, state.cargo, state.cargo_hold, state.id);
-		cargo_type = (cargo_type + i) % n_cargo;
-		if (shm_offer_get_quantity(state.general, state.offer, state.curr_port_id, cargo_type) <= 0)
-			continue;
+	if (get_pipeline(state.general)) {
+		/* Both phases are loaded and unloaded at once */
 		sigprocmask(SIG_BLOCK, &mask, NULL);
-		tons_moved = buy(cargo_type);
+		remove_expired();
+		tons_moved = sell_all();
+		commit_reservation();
+		tons_moved += buy_all();
 		sigprocmask(SIG_UNBLOCK, &mask, NULL);
 		if (tons_moved > 0)
-			convert_and_sleep(tons_moved / (double)load_speed);
+			convert_and_sleep_interruptible(tons_moved / (double)load_speed, join_checkpoint);
+	} else {
+		/* Selling */
+		if (shm_ship_get_capacity(state.ship, state.id) < get_capacity(state.general)) {
+			for (i = 0; i < n_row; i++) {
+				sigprocmask(SIG_BLOCK, &mask, NULL);
+				remove_expired();
+				tons_moved = sell(shm_demand_get_row_type(state.general, state.demand,
+									  state.curr_port_id, i));
+				sigprocmask(SIG_UNBLOCK, &mask, NULL);
+				if (tons_moved > 0)
+					convert_and_sleep_interruptible(tons_moved / (double)load_speed,
+									join_checkpoint);
+			}
+		}
+		commit_reservation();
+
+		/* Buying */
+		first = RANDOM_INTEGER(0, n_row - 1);
+		for (i = 0; i < n_row; i++) {
+			if (shm_ship_get_capacity(state.ship, state.id) <= 0) break;
+			if (shm_offer_get_row_quantity(state.general, state.offer, state.curr_port_id,
+						       (first + i) % n_row) <= 0)
+				continue;
+			cargo_type = shm_offer_get_row_type(state.general, state.offer, state.curr_port_id,
+							    (first + i) % n_row);
+			sigprocmask(SIG_BLOCK, &mask, NULL);
+			remove_expired();
+			tons_moved = buy(cargo_type);
+			sigprocmask(SIG_UNBLOCK, &mask, NULL);
+			if (tons_moved > 0)
+				convert_and_sleep_interruptible(tons_moved / (double)load_speed, join_checkpoint);
+		}
 	}
 
-	/* Releasing dock */
+	/* Releasing dock, a day lasts a second */
 	sem_execute_semop(sem_docks_id, state.curr_port_id, 1, SEM_UNDO);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	shm_port_leave_queue(state.port, state.curr_port_id, (get_time_ns() - dock_ns) / 1e9);
+	state.queued_port = -1;
+	sigprocmask(SIG_UNBLOCK, &mask, NULL);
 	shm_ship_set_is_at_dock(state.ship, state.id, FALSE);
 
 }
 
+/**
+ * @brief Releases the reservation of the demand of the port once the ship sold there.
+ */
+void commit_reservation(void)
+{
+	sigset_t mask, old_mask;
+	int released;
+
+	sigfillset(&mask);
+	sigprocmask(SIG_BLOCK, &mask, &old_mask);
+	released = shm_demand_commit(state.demand, state.general, state.id);
+	if (released >= 0)
+		shm_port_market_changed(state.port, released);
+	sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+/**
+ * @brief Gets how many lots of a cargo type the ship can sell at the current port.
+ */
+int get_amount_to_sell(int cargo_type)
+{
+	int available_in_ship, port_demand;
+
+	available_in_ship = cargo_list_get_quantity(state.cargo_hold[cargo_type]);
+
+	/* The demand reserved by the other ships is not for sale */
+	port_demand = shm_demand_get_available(state.general, state.demand, state.curr_port_id, cargo_type)
+		+ shm_demand_get_reserved(state.general, state.demand, state.id, state.curr_port_id, cargo_type);
+	return MIN(available_in_ship, port_demand);
+}
+
 int sell(int cargo_type)
 {
 	struct commerce_msg msg;
-	int available_in_ship, port_demand, amount_to_sell;
+	int amount_to_sell;
 	int quantity, status;
+	unsigned long start_ns;
 
-	available_in_ship = 0;
-	available_in_ship += cargo_list_get_quantity(state.cargo_hold[cargo_type]);
-
-	port_demand = shm_demand_get_quantity(state.general, state.demand, state.curr_port_id, cargo_type);
-	amount_to_sell = MIN(available_in_ship, port_demand);
+	amount_to_sell = get_amount_to_sell(cargo_type);
 	if (amount_to_sell <= 0) return 0;
 
 	msg = msg_commerce_create(state.curr_port_id, state.id, cargo_type, amount_to_sell, -1, STATUS_SELL);
-	msg_commerce_send(msg_in_get_id(state.general), &msg);
-	msg_commerce_receive(msg_out_get_id(state.general), state.id, NULL, NULL, &quantity, NULL, &status, TRUE);
+	start_ns = get_time_ns();
+	msg_commerce_send(msg_in_get_id(state.general, state.shard), &msg);
+	msg_commerce_receive(msg_out_get_id(state.general, state.shard), state.id, NULL, NULL, &quantity, NULL, &status, TRUE);
+	shm_stats_record_since(state.stats, state.stats_slot, LAT_SELL_RTT, start_ns);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_SENT, 1);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_RECEIVED, 1);
 
 	if (status == STATUS_ACCEPTED && quantity > 0) {
+		shm_stats_count(state.stats, state.stats_slot, CNT_DELIVERED, quantity);
 		return ship_sell(quantity, cargo_type);
 	}
 	return 0;
 }
 
+/**
+ * @brief Sends a sell request for every cargo type, then reads the replies.
+ * 	At most PIPELINE_MAX requests are in flight, so that the ships of a
+ * 	port cannot fill the queues before the port gets to reply.
+ * @return The tons sold.
+ */
+int sell_all(void)
+{
+	struct commerce_msg msg;
+	int i, type, amount, n_requests = 0, n_sent = 0, tons_sold = 0;
+	unsigned long start_ns;
+
+	start_ns = get_time_ns();
+	for (i = 0; i < get_port_types(state.general); i++) {
+		type = shm_demand_get_row_type(state.general, state.demand, state.curr_port_id, i);
+		amount = get_amount_to_sell(type);
+		if (amount <= 0) continue;
+		if (n_requests == PIPELINE_MAX)
+			n_requests -= receive_sold(&tons_sold);
+		msg = msg_commerce_create(state.curr_port_id, state.id, type, amount, -1, STATUS_SELL);
+		msg_commerce_send(msg_in_get_id(state.general, state.shard), &msg);
+		n_requests++;
+		n_sent++;
+	}
+	if (n_sent == 0)
+		return 0;
+
+	while (n_requests > 0)
+		n_requests -= receive_sold(&tons_sold);
+	shm_stats_record_since(state.stats, state.stats_slot, LAT_SELL_RTT, start_ns);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_SENT, n_sent);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_RECEIVED, n_sent);
+	return tons_sold;
+}
+
+/**
+ * @brief Reads the reply to one of the sell requests of sell_all().
+ * @param tons_sold incremented with the tons sold.
+ * @return The number of requests answered, always 1.
+ */
+int receive_sold(int *tons_sold)
+{
+	int cargo_type, quantity, status;
+
+	/* With dock workers the replies may come in any order */
+	msg_commerce_receive(msg_out_get_id(state.general, state.shard), state.id, NULL, &cargo_type, &quantity, NULL, &status, TRUE);
+	if (status == STATUS_ACCEPTED && quantity > 0) {
+		shm_stats_count(state.stats, state.stats_slot, CNT_DELIVERED, quantity);
+		*tons_sold += ship_sell(quantity, cargo_type);
+	}
+	return 1;
+}
+
 int ship_sell(int amount_to_sell, int cargo_type)
 {
 	int tons_sold;
-	cargo_list_pop_needed(state.cargo_hold[cargo_type], amount_to_sell);
+	cargo_list_consume(state.cargo_hold[cargo_type], amount_to_sell, NULL, NULL);
 
 	tons_sold = amount_to_sell * shm_cargo_get_size(state.cargo, cargo_type);
 	shm_ship_update_capacity(state.ship, state.id, tons_sold);
@@ -268,34 +458,122 @@ int ship_sell(int amount_to_sell, int cargo_type)
 int buy(int cargo_type)
 {
 	struct commerce_msg msg;
-	int msg_out_id;
 	int available_ship_capacity, n_in_capacity, amount_to_buy;
 	int available_in_port;
 	int tons_bought = 0;
-	int quantity, expiration_date, status;
+	unsigned long start_ns;
 	available_in_port = shm_offer_get_quantity(state.general, state.offer, state.curr_port_id, cargo_type);
 	available_ship_capacity = shm_ship_get_capacity(state.ship, state.id);
 	n_in_capacity = available_ship_capacity / shm_cargo_get_size(state.cargo, cargo_type);
 	if (n_in_capacity <= 0) return 0;
 	amount_to_buy = RANDOM_INTEGER(1, MIN(n_in_capacity, available_in_port));
 	msg = msg_commerce_create(state.curr_port_id, state.id, cargo_type, amount_to_buy, -1, STATUS_BUY);
-	msg_commerce_send(msg_in_get_id(state.general), &msg);
+	start_ns = get_time_ns();
+	msg_commerce_send(msg_in_get_id(state.general, state.shard), &msg);
 
-	msg_out_id = msg_out_get_id(state.general);
 	do {
-		msg_commerce_receive(msg_out_id, state.id, NULL, NULL, &quantity, &expiration_date, &status, TRUE);
-		if (status == STATUS_PARTIAL || status == STATUS_ACCEPTED) {
-			tons_bought += ship_buy(cargo_type, quantity, expiration_date);
+		tons_bought += receive_lots(&msg);
+		shm_stats_count(state.stats, state.stats_slot, CNT_MSG_RECEIVED, 1);
+	} while (msg.status == STATUS_PARTIAL);
+	shm_stats_record_since(state.stats, state.stats_slot, LAT_BUY_RTT, start_ns);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_SENT, 1);
+
+	return tons_bought;
+}
+
+/**
+ * @brief Sends a buy request for every cargo type offered by the port within
+ * 	the free capacity, then reads the lots. At most PIPELINE_MAX requests
+ * 	are in flight, as in sell_all().
+ * @return The tons bought.
+ */
+int buy_all(void)
+{
+	struct commerce_msg msg;
+	int i, n_row, type, first, available_in_port, free_tons, size, amount;
+	int n_requests = 0, n_sent = 0, n_received = 0, tons_bought = 0;
+	unsigned long start_ns;
+
+	n_row = get_port_types(state.general);
+	free_tons = shm_ship_get_capacity(state.ship, state.id);
+	first = RANDOM_INTEGER(0, n_row - 1);
+	start_ns = get_time_ns();
+	for (i = 0; i < n_row && free_tons > 0; i++) {
+		type = shm_offer_get_row_type(state.general, state.offer, state.curr_port_id, (first + i) % n_row);
+		available_in_port = shm_offer_get_row_quantity(state.general, state.offer, state.curr_port_id,
+							       (first + i) % n_row);
+		size = shm_cargo_get_size(state.cargo, type);
+		if (available_in_port <= 0 || free_tons < size) continue;
+		amount = RANDOM_INTEGER(1, MIN(free_tons / size, available_in_port));
+		free_tons -= amount * size;
+		while (n_requests == PIPELINE_MAX) {
+			n_requests -= receive_bought(&tons_bought);
+			n_received++;
 		}
-	} while (status == STATUS_PARTIAL);
+		msg = msg_commerce_create(state.curr_port_id, state.id, type, amount, -1, STATUS_BUY);
+		msg_commerce_send(msg_in_get_id(state.general, state.shard), &msg);
+		n_requests++;
+		n_sent++;
+	}
+	if (n_sent == 0)
+		return 0;
 
+	while (n_requests > 0) {
+		n_requests -= receive_bought(&tons_bought);
+		n_received++;
+	}
+	shm_stats_record_since(state.stats, state.stats_slot, LAT_BUY_RTT, start_ns);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_SENT, n_sent);
+	shm_stats_count(state.stats, state.stats_slot, CNT_MSG_RECEIVED, n_received);
 	return tons_bought;
 }
 
+/**
+ * @brief Waits for a reply to a buy request and loads the lots it carries.
+ * @param msg Where the reply is stored.
+ * @return The tons bought.
+ */
+int receive_lots(struct commerce_msg *msg)
+{
+	int i, tons_bought = 0;
+
+	while (msg_commerce_receive_msg(msg_out_get_id(state.general, state.shard), state.id, msg, TRUE) == FALSE);
+	if (msg->status == STATUS_PARTIAL || msg->status == STATUS_ACCEPTED)
+		for (i = 0; i < msg->n_lots; i++)
+			tons_bought += ship_buy(msg->cargo_id, msg->lots[i].quantity, msg->lots[i].expiry_date);
+	return tons_bought;
+}
+
+/**
+ * @brief Reads one reply for the buy requests of buy_all().
+ * @param tons_bought incremented with the tons bought.
+ * @return The number of requests answered: every request ends with an
+ * 	accepted reply or a refusal, a partial reply leaves it open.
+ */
+int receive_bought(int *tons_bought)
+{
+	struct commerce_msg msg;
+
+	*tons_bought += receive_lots(&msg);
+	return msg.status == STATUS_PARTIAL ? 0 : 1;
+}
+
+/**
+ * @brief Removes the expired cargo from the hold, only when the oldest lot
+ * 	may have expired since the last sweep.
+ */
+void remove_expired(void)
+{
+	if (get_current_day(state.general) > state.next_expire)
+		state.next_expire = shm_ship_remove_expired(state.general, state.ship, state.cargo,
+							    state.cargo_hold, state.id);
+}
+
 int ship_buy(int cargo_type, int amount_to_buy, int expiration_date)
 {
 	int tons_bought;
 	cargo_list_add(state.cargo_hold[cargo_type], amount_to_buy, expiration_date);
+	state.next_expire = MIN(state.next_expire, expiration_date);
 
 	tons_bought = amount_to_buy * shm_cargo_get_size(state.cargo, cargo_type);
 	shm_ship_update_capacity(state.ship, state.id, -tons_bought);
@@ -308,6 +586,10 @@ int ship_buy(int cargo_type, int amount_to_buy, int expiration_date)
 void signal_handler(int signal)
 {
 	switch (signal) {
+	case SIGDAY:
+		/* The hold is saved out of the handler, see join_checkpoint() */
+		state.checkpoint_asked = 1;
+		break;
 	case SIGSTORM:
 		shm_ship_set_dump_had_storm(state.ship, state.id);
 		convert_and_sleep(get_storm_duration(state.general) / 24.0);
@@ -324,21 +606,46 @@ void signal_handler(int signal)
 	}
 }
 
+/**
+ * @brief Joins the pending checkpoint if SIGDAY asked for it. Called only
+ * 	between two trades, the hold is never modified while SIGDAY is blocked.
+ */
+void join_checkpoint(void)
+{
+	if (!state.checkpoint_asked)
+		return;
+	state.checkpoint_asked = 0;
+	if (get_checkpoint_phase(state.general) != CHECKPOINT_SHIPS
+	    || get_checkpoint_day(state.general) == state.joined_day)
+		return;
+	state.joined_day = get_checkpoint_day(state.general);
+	checkpoint_join(state.general, checkpoint_ship_slot(state.general, state.id), state.cargo_hold);
+}
+
 void close_all(void)
 {
-	int i;
+	int i, released;
 
 	for (i = 0; i < get_merci(state.general); i++) {
 		cargo_list_delete(state.cargo_hold[i]);
 	}
 	free(state.cargo_hold);
-
+	free(state.reservation);
+	cargo_list_pool_destroy();
+	route_plan_destroy();
+
+	released = shm_demand_commit(state.demand, state.general, state.id);
+	if (released >= 0)
+		shm_port_market_changed(state.port, released);
+	if (state.queued_port >= 0)
+		shm_port_leave_queue(state.port, state.queued_port, -1);
 	shm_ship_set_is_dead(state.ship, state.id);
 	shm_port_detach(state.port);
 	shm_ship_detach(state.ship);
 	shm_cargo_detach(state.cargo);
 	shm_offer_detach(state.offer);
 	shm_demand_detach(state.demand);
+	shm_stats_detach(state.stats);
 	shm_general_detach(state.general);
 	exit(EXIT_SUCCESS);
 }
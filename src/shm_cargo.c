@@ -51,14 +51,12 @@ static void shm_cargo_values_init(shm_general_t *g, shm_cargo_t *cargo)
 shm_cargo_t *shm_cargo_initialize(shm_general_t *g)
 {
 	shm_cargo_t *cargo;
-	int shm_id, n_cargo;
+	int shm_id, id_min;
 	size_t size;
 
-	n_cargo = get_merci(g);
-
-	size = sizeof(struct shm_cargo) * n_cargo;
+	size = shm_cargo_get_segment_size(g);
 
-	shm_id = shm_create(SHM_DATA_CARGO_KEY, size);
+	shm_id = shm_create(ipc_key(SHM_DATA_CARGO_KEY), size);
 	if (shm_id == -1) {
 		return NULL;
 	}
@@ -68,10 +66,17 @@ shm_cargo_t *shm_cargo_initialize(shm_general_t *g)
 	shm_cargo_set_id(g, shm_id);
 
 	shm_cargo_values_init(g, cargo);
+	id_min = shm_cargo_get_min_size_id(cargo, g);
+	set_size_min(g, id_min, cargo[id_min].batch_size);
 
 	return cargo;
 }
 
+size_t shm_cargo_get_segment_size(shm_general_t *g)
+{
+	return sizeof(struct shm_cargo) * get_merci(g);
+}
+
 shm_cargo_t *shm_cargo_attach(shm_general_t *g)
 {
 	shm_cargo_t *cargo;
@@ -125,6 +130,14 @@ void shm_cargo_update_dump_total_generated(shm_cargo_t *c, int id, int quantity,
 	sem_execute_semop(sem_cargo_id, id, 1, 0);
 }
 
+void shm_cargo_update_dump_generated(shm_cargo_t *c, int id, int quantity, int sem_cargo_id)
+{
+	sem_execute_semop(sem_cargo_id, id, -1, 0);
+	c[id].dump_total_generated += quantity;
+	c[id].dump_available_in_port += quantity;
+	sem_execute_semop(sem_cargo_id, id, 1, 0);
+}
+
 void shm_cargo_update_dump_expired_in_port(shm_cargo_t *c, int id, int quantity, int sem_cargo_id)
 {
 	sem_execute_semop(sem_cargo_id, id, -1, 0);
@@ -145,6 +158,13 @@ void shm_cargo_update_dump_received_in_port(shm_cargo_t *c, int id, int quantity
 	c[id].dump_received_in_port += quantity;
 	sem_execute_semop(sem_cargo_id, id, 1, 0);
 }
+void shm_cargo_update_dump_port_trade(shm_cargo_t *c, int id, int received, int shipped, int sem_cargo_id)
+{
+	sem_execute_semop(sem_cargo_id, id, -1, 0);
+	c[id].dump_received_in_port += received;
+	c[id].dump_available_in_port -= shipped;
+	sem_execute_semop(sem_cargo_id, id, 1, 0);
+}
 void shm_cargo_update_dump_available_in_port(shm_cargo_t *c, int id, int quantity, int sem_cargo_id)
 {
 	sem_execute_semop(sem_cargo_id, id, -1, 0);
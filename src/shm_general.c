@@ -1,13 +1,20 @@
 #define _GNU_SOURCE
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../lib/shm.h"
 
 #include "include/const.h"
 #include "include/shm_general.h"
 #include "include/msg_commerce.h"
+#include "include/utils.h"
 #include "../lib/semaphore.h"
 
 struct shm_general {
@@ -17,13 +24,53 @@ struct shm_general {
 	int so_porti, so_banchine, so_fill, so_loadspeed;
 	int so_merci, so_size, so_min_vita, so_max_vita;
 	int so_storm_duration, so_swell_duration, so_maelstrom;
+	int so_day_lag, so_dock_workers, so_pipeline, so_sparse_max, so_shards;
+
+	/* Derived from the constants by validate_constants() and shm_cargo_initialize() */
+	int daily_fill;
+	int port_types;
+	int regions;
+	double inv_speed;
+	int size_min_id, size_min;
 
 	int current_day;
+	unsigned long day_tick_ns;
+
+	int checkpoint_day, restore_day;
+	int checkpoint_phase, checkpoint_joined;
+	char checkpoint_path[CHECKPOINT_PATH_MAX];
+	char restore_path[CHECKPOINT_PATH_MAX];
 
 	int general_shm_id, ship_shm_id, port_shm_id, cargo_shm_id;
-	int offer_shm_id, demand_shm_id;
-	int msg_in_id, msg_out_id;
-	int sem_start_id, sem_port_init_id, sem_cargo_id;
+	int offer_shm_id, demand_shm_id, stats_shm_id;
+	int msg_in_id[SHARD_MAX], msg_out_id[SHARD_MAX];
+	int sem_start_id, sem_port_init_id, sem_cargo_id, sem_epoch_id, sem_reservation_id;
+	int sem_checkpoint_id;
+};
+
+/* Offset of the field of a constant, every constant but SO_LATO is an int */
+#define FIELD(name) offsetof(struct shm_general, name)
+
+static const struct constant {
+	const char *name;
+	size_t offset;
+	double min, max;
+	double def;	/* value of an optional constant that is not set, 0 if required */
+} constants[NUM_CONST] = {
+	{ "SO_LATO", FIELD(so_lato), 1, 1e9, 0 }, { "SO_DAYS", FIELD(so_days), 1, INT_MAX, 0 },
+	{ "SO_NAVI", FIELD(so_navi), 1, INT_MAX, 0 }, { "SO_SPEED", FIELD(so_speed), 1, INT_MAX, 0 },
+	{ "SO_CAPACITY", FIELD(so_capacity), 1, INT_MAX, 0 },
+	{ "SO_PORTI", FIELD(so_porti), 4, PORTI_MAX, 0 }, { "SO_BANCHINE", FIELD(so_banchine), 1, INT_MAX, 0 },
+	{ "SO_FILL", FIELD(so_fill), 1, INT_MAX, 0 }, { "SO_LOADSPEED", FIELD(so_loadspeed), 1, INT_MAX, 0 },
+	{ "SO_MERCI", FIELD(so_merci), 1, INT_MAX, 0 }, { "SO_SIZE", FIELD(so_size), 1, INT_MAX, 0 },
+	{ "SO_MIN_VITA", FIELD(so_min_vita), 1, INT_MAX, 0 }, { "SO_MAX_VITA", FIELD(so_max_vita), 1, INT_MAX, 0 },
+	{ "SO_STORM_DURATION", FIELD(so_storm_duration), 0, INT_MAX, 0 },
+	{ "SO_SWELL_DURATION", FIELD(so_swell_duration), 0, INT_MAX, 0 },
+	{ "SO_MAELSTROM", FIELD(so_maelstrom), 1, INT_MAX, 0 },
+	/* Optional */
+	{ "SO_DAY_LAG", FIELD(so_day_lag), -1, INT_MAX, -1 },
+	{ "SO_DOCK_WORKERS", FIELD(so_dock_workers), 0, INT_MAX, 0 }, { "SO_PIPELINE", FIELD(so_pipeline), 0, 1, 0 },
+	{ "SO_SPARSE_MAX", FIELD(so_sparse_max), 0, INT_MAX, 0 }, { "SO_SHARDS", FIELD(so_shards), 0, 4, 0 }
 };
 
 /**
@@ -32,6 +79,28 @@ struct shm_general {
  */
 static void shm_general_set_id(shm_general_t *g);
 
+/**
+ * @brief Creates and attaches the shared memory segment for the general structure.
+ * @return Pointer to the general structure or NULL if the segment already
+ * 	exists, i.e. another simulation is using the same IPC namespace.
+ */
+static shm_general_t *shm_general_create(void);
+
+/**
+ * @brief Parses a line of the configuration file, "SO_NAVI=1000" or a
+ * 	positional value, and sets the constant.
+ * @param line The line, without the comment.
+ * @param g Pointer to the general shared memory structure.
+ * @param counter Number of positional values read so far.
+ * @param set Which constants were already set.
+ * @return The index of the constant or -1 on error.
+ */
+static int parse_line(char *line, shm_general_t *g, int *counter, bool_t *set);
+
+static double get_constant(shm_general_t *g, int index);
+static bool_t check_constant(int index, double value);
+static char *trim(char *str);
+
 void remove_comment(char *str);
 
 void remove_comment(char *str) {
@@ -43,75 +112,304 @@ void remove_comment(char *str) {
 
 shm_general_t *read_from_path(char *path, shm_general_t **g)
 {
-	FILE *file;
-	char buffer[100];
+	int fd, i, n_line = 0;
+	struct stat st;
+	const char *map, *cur, *end, *eol;
+	char buffer[128];
 	int counter = 0;
-	double value;
-	shm_general_t *data = *g;
+	bool_t set[NUM_CONST];
+	shm_general_t *data;
 
-	shm_general_attach(&data);
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return NULL;
+	}
+	if (fstat(fd, &st) == -1 || st.st_size == 0) {
+		dprintf(2, "shm_general.c: %s is empty.\n", path);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
 
-	file = fopen(path, "r");
-	if (file == NULL) {
+	data = shm_general_create();
+	if (data == NULL) {
+		munmap((void *)map, st.st_size);
 		return NULL;
 	}
+	*g = data;
+	shm_general_set_id(data);
 
-	while(fgets(buffer, sizeof(buffer), file) != NULL) {
+	for (i = 0; i < NUM_CONST; i++)
+		set[i] = FALSE;
+
+	end = map + st.st_size;
+	for (cur = map; cur < end; cur = eol + 1) {
+		eol = memchr(cur, '\n', end - cur);
+		if (eol == NULL)
+			eol = end;
+		n_line++;
+
+		if ((size_t)(eol - cur) >= sizeof(buffer)) {
+			dprintf(2, "shm_general.c: %s:%d: line too long.\n", path, n_line);
+			break;
+		}
+		memcpy(buffer, cur, eol - cur);
+		buffer[eol - cur] = '\0';
 		remove_comment(buffer);
-		if (buffer[0] == '\n' || buffer[0] == '\r' ||
-		    buffer[0] == '\0') {
+		if (*trim(buffer) == '\0')
 			continue;
-		}
 
-		if(counter >= NUM_CONST) {
-			fclose(file);
-			return NULL;
-		}
-		value = strtod(buffer, NULL);
-		if(value < 0) {
-			fclose(file);
-			return NULL;
+		if (parse_line(buffer, data, &counter, set) == -1) {
+			dprintf(2, "shm_general.c: %s:%d: not a valid constant.\n", path, n_line);
+			break;
 		}
-		if(counter <= 0) {
-			data->so_lato = value;
-		} else {
-			(&data->so_days)[counter - 1] = (int)value;
+	}
+	munmap((void *)map, st.st_size);
+
+	for (i = NUM_REQUIRED_CONST; i < NUM_CONST; i++)
+		if (set[i] == FALSE)
+			set_constant(data, i, constants[i].def);
+	for (i = 0; cur >= end && i < NUM_CONST; i++) {
+		if (set[i] == FALSE && i < NUM_REQUIRED_CONST) {
+			dprintf(2, "shm_general.c: %s: %s is missing.\n", path, constants[i].name);
+			break;
 		}
-		counter++;
+	}
+	if (cur < end || i < NUM_CONST || validate_constants(data) == FALSE) {
+		shm_general_delete(data->general_shm_id);
+		return NULL;
 	}
 
 	data->current_day = 0;
-	fclose(file);
+	data->checkpoint_day = -1;
+	data->checkpoint_phase = CHECKPOINT_IDLE;
+	data->restore_day = -1;
+	data->checkpoint_path[0] = '\0';
+	data->restore_path[0] = '\0';
 
-	shm_general_set_id(data);
 	return data;
 }
 
-void shm_general_ipc_init(shm_general_t *g)
+static int parse_line(char *line, shm_general_t *g, int *counter, bool_t *set)
+{
+	char *value_str, *end;
+	double value;
+	int index;
+
+	value_str = strchr(line, '=');
+	if (value_str != NULL) {
+		*value_str++ = '\0';
+		index = get_constant_index(trim(line));
+	} else {
+		value_str = line;
+		index = *counter < NUM_CONST ? (*counter)++ : -1;
+	}
+	if (index == -1 || set[index] == TRUE) {
+		return -1;
+	}
+
+	value_str = trim(value_str);
+	value = strtod(value_str, &end);
+	if (end == value_str || *end != '\0' || check_constant(index, value) == FALSE) {
+		return -1;
+	}
+	set_constant(g, index, value);
+	set[index] = TRUE;
+
+	return index;
+}
+
+static char *trim(char *str)
+{
+	char *end;
+
+	while (*str == ' ' || *str == '\t' || *str == '\r')
+		str++;
+	end = str + strlen(str);
+	while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+		*--end = '\0';
+	return str;
+}
+
+static double get_constant(shm_general_t *g, int index)
+{
+	char *field = (char *)g + constants[index].offset;
+
+	return index == 0 ? *(double *)field : *(int *)field;
+}
+
+static bool_t check_constant(int index, double value)
+{
+	if (value < constants[index].min || value > constants[index].max ||
+	    (index > 0 && value != (int)value)) {
+		dprintf(2, "shm_general.c: %s must be %s between %.0f and %.0f.\n", constants[index].name,
+			index > 0 ? "an integer" : "a number", constants[index].min, constants[index].max);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t validate_constants(shm_general_t *g)
+{
+	int i;
+
+	for (i = 0; i < NUM_CONST; i++)
+		if (check_constant(i, get_constant(g, i)) == FALSE)
+			return FALSE;
+	if (g->so_min_vita > g->so_max_vita) {
+		dprintf(2, "shm_general.c: SO_MIN_VITA must not exceed SO_MAX_VITA.\n");
+		return FALSE;
+	}
+	if (g->so_fill < g->so_days) {
+		dprintf(2, "shm_general.c: SO_FILL must be at least SO_DAYS.\n");
+		return FALSE;
+	}
+
+	g->daily_fill = g->so_fill / g->so_days;
+	g->port_types = g->so_sparse_max > 0 && g->so_sparse_max < g->so_merci ? g->so_sparse_max : g->so_merci;
+	g->regions = g->so_shards > 0 ? g->so_shards * g->so_shards : 1;
+	g->inv_speed = 1.0 / g->so_speed;
+	return TRUE;
+}
+
+int get_constant_index(const char *name)
+{
+	int i;
+
+	for (i = 0; i < NUM_CONST; i++)
+		if (strcmp(constants[i].name, name) == 0)
+			return i;
+	return -1;
+}
+
+void set_constant(shm_general_t *g, int index, double value)
+{
+	char *field = (char *)g + constants[index].offset;
+
+	if (index == 0)
+		*(double *)field = value;
+	else
+		*(int *)field = (int)value;
+}
+
+shm_general_t *shm_general_restore(const void *data, size_t size, int day, const char *path, shm_general_t **g)
+{
+	shm_general_t *restored;
+
+	if (size != sizeof(shm_general_t) || strlen(path) >= CHECKPOINT_PATH_MAX) {
+		return NULL;
+	}
+
+	restored = shm_general_create();
+	if (restored == NULL) {
+		return NULL;
+	}
+	*g = restored;
+	memcpy(restored, data, size);
+
+	restored->current_day = day;
+	restored->day_tick_ns = get_time_ns();
+	restored->checkpoint_day = -1;
+	restored->checkpoint_phase = CHECKPOINT_IDLE;
+	restored->checkpoint_joined = 0;
+	restored->restore_day = day;
+	restored->checkpoint_path[0] = '\0';
+	strcpy(restored->restore_path, path);
+
+	shm_general_set_id(restored);
+	return restored;
+}
+
+bool_t shm_general_ipc_init(shm_general_t *g)
 {
 	int i;
 	/* Semaphores */
-	g->sem_start_id = sem_create(SEM_START_KEY, 1);
+	g->sem_start_id = ipc_sem_create(SEM_START_KEY, 1);
+	g->sem_port_init_id = ipc_sem_create(SEM_PORTS_INITIALIZED_KEY, g->so_porti);
+	g->sem_cargo_id = ipc_sem_create(SEM_CARGO_KEY, g->so_merci);
+	g->sem_epoch_id = ipc_sem_create(SEM_EPOCH_KEY, g->so_porti);
+	g->sem_reservation_id = ipc_sem_create(SEM_RESERVATION_KEY, g->so_porti);
+	g->sem_checkpoint_id = ipc_sem_create(SEM_CHECKPOINT_KEY, 1);
+
+	/* Message queues */
+	for (i = 0; i < g->regions; i++) {
+		g->msg_in_id[i] = msg_commerce_in_port_init(i);
+		g->msg_out_id[i] = msg_commerce_out_port_init(i);
+	}
+	for (i = 0; i < g->regions; i++) {
+		if (g->msg_in_id[i] == -1 || g->msg_out_id[i] == -1) {
+			shm_general_ipc_delete(g);
+			return FALSE;
+		}
+	}
+	if (g->sem_start_id == -1 || g->sem_port_init_id == -1 || g->sem_cargo_id == -1
+	    || g->sem_epoch_id == -1 || g->sem_reservation_id == -1 || g->sem_checkpoint_id == -1) {
+		shm_general_ipc_delete(g);
+		return FALSE;
+	}
+
 	sem_setval(g->sem_start_id, 0, 1);
-	g->sem_port_init_id = sem_create(SEM_PORTS_INITIALIZED_KEY, g->so_porti);
 	sem_setval(g->sem_port_init_id, 0, g->so_porti);
-	g->sem_cargo_id = sem_create(SEM_CARGO_KEY, g->so_merci);
 	for (i = 0; i < g->so_merci; i++)
 		sem_setval(g->sem_cargo_id, i, 1);
+	for (i = 0; i < g->so_porti; i++) {
+		/* The first day is left to process, see increase_day() */
+		sem_setval(g->sem_epoch_id, i, 1);
+		/* One lock per port for the reservations of its demand */
+		sem_setval(g->sem_reservation_id, i, 1);
+	}
+	/* Closed while a snapshot is taken, see checkpoint_join() */
+	sem_setval(g->sem_checkpoint_id, 0, 0);
+	return TRUE;
+}
 
-	/* Message queues */
-	g->msg_in_id = msg_commerce_in_port_init();
-	g->msg_out_id = msg_commerce_out_port_init();
+void shm_general_ipc_delete(shm_general_t *g)
+{
+	int sem_ids[6];
+	int i;
+
+	sem_ids[0] = g->sem_start_id;
+	sem_ids[1] = g->sem_port_init_id;
+	sem_ids[2] = g->sem_cargo_id;
+	sem_ids[3] = g->sem_epoch_id;
+	sem_ids[4] = g->sem_reservation_id;
+	sem_ids[5] = g->sem_checkpoint_id;
+	for (i = 0; i < 6; i++)
+		if (sem_ids[i] != -1)
+			sem_delete(sem_ids[i]);
+	for (i = 0; i < g->regions; i++) {
+		if (g->msg_in_id[i] != -1)
+			msgctl(g->msg_in_id[i], IPC_RMID, NULL);
+		if (g->msg_out_id[i] != -1)
+			msgctl(g->msg_out_id[i], IPC_RMID, NULL);
+	}
 }
 
 /* General shared memory */
+static shm_general_t *shm_general_create(void)
+{
+	int shm_id;
+
+	shm_id = shm_create(ipc_key(SHM_DATA_GENERAL_KEY), sizeof(shm_general_t));
+	if (shm_id == -1) {
+		dprintf(2, "shm_general.c: IPC namespace %d is already in use.\n", ipc_get_namespace());
+		return NULL;
+	}
+	return shm_attach(shm_id);
+}
+
 void shm_general_attach(shm_general_t **g)
 {
 	int shm_id;
 
-	shm_id = shm_create(SHM_DATA_GENERAL_KEY, sizeof(shm_general_t));
+	shm_id = shm_get_id(ipc_key(SHM_DATA_GENERAL_KEY));
 	if (shm_id == -1) {
-		dprintf(1, "do something\n");
+		*g = NULL;
+		return;
 	}
 	*g = shm_attach(shm_id);
 }
@@ -120,12 +418,13 @@ void shm_general_detach(shm_general_t *g){shm_detach(g);}
 void shm_general_delete(int id){shm_delete(id);}
 
 /* Setters */
-static void shm_general_set_id(shm_general_t *g){g->general_shm_id = shm_create(SHM_DATA_GENERAL_KEY, 0);}
+static void shm_general_set_id(shm_general_t *g){g->general_shm_id = shm_get_id(ipc_key(SHM_DATA_GENERAL_KEY));}
 void shm_ship_set_id(shm_general_t *g, int id){g->ship_shm_id = id;}
 void shm_port_set_id(shm_general_t *g, int id){g->port_shm_id = id;}
 void shm_cargo_set_id(shm_general_t *g, int id){g->cargo_shm_id = id;}
 void shm_offer_set_id(shm_general_t *g, int id){g->offer_shm_id = id;}
 void shm_demand_set_id(shm_general_t *g, int id){g->demand_shm_id = id;}
+void shm_stats_set_id(shm_general_t *g, int id){g->stats_shm_id = id;}
 
 /* Getters */
 int shm_general_get_id(shm_general_t *g){ return g->general_shm_id; }
@@ -134,36 +433,114 @@ int shm_port_get_id(shm_general_t *g){return g->port_shm_id;}
 int shm_cargo_get_id(shm_general_t *g){return g->cargo_shm_id;}
 int shm_offer_get_id(shm_general_t *g){	return g->offer_shm_id;}
 int shm_demand_get_id(shm_general_t *g){return g->demand_shm_id;}
+int shm_stats_get_id(shm_general_t *g){return g->stats_shm_id;}
 
 int sem_start_get_id(shm_general_t *g){return g->sem_start_id;}
 int sem_port_init_get_id(shm_general_t *g){return g->sem_port_init_id;}
 int sem_cargo_get_id(shm_general_t *g){return g->sem_cargo_id;}
+int sem_epoch_get_id(shm_general_t *g){return g->sem_epoch_id;}
+int sem_reservation_get_id(shm_general_t *g){return g->sem_reservation_id;}
+int sem_checkpoint_get_id(shm_general_t *g){return g->sem_checkpoint_id;}
 
-int msg_in_get_id(shm_general_t *g){return g->msg_in_id;}
-int msg_out_get_id(shm_general_t *g){return g->msg_out_id;}
+int msg_in_get_id(shm_general_t *g, int shard){return g->msg_in_id[shard];}
+int msg_out_get_id(shm_general_t *g, int shard){return g->msg_out_id[shard];}
 
 
 /* Getters for simulation costants */
-double get_lato(shm_general_t *g){ return g->so_lato; }
-int get_days(shm_general_t *g){	return g->so_days; }
-int get_navi(shm_general_t *g){	return g->so_navi; }
-int get_speed(shm_general_t *g){ return g->so_speed; }
-int get_capacity(shm_general_t *g){ return g->so_capacity; }
-int get_porti(shm_general_t *g){ return g->so_porti; }
-int get_banchine(shm_general_t *g){ return g->so_banchine; }
-int get_fill(shm_general_t *g){	return g->so_fill; }
-int get_load_speed(shm_general_t *g){ return g->so_loadspeed; }
-int get_merci(shm_general_t *g){ return g->so_merci; }
-int get_size(shm_general_t *g){	return g->so_size; }
-int get_min_vita(shm_general_t *g){ return g->so_min_vita; }
-int get_max_vita(shm_general_t *g){ return g->so_max_vita; }
-int get_storm_duration(shm_general_t *g){ return g->so_storm_duration; }
-int get_swell_duration(shm_general_t *g){ return g->so_swell_duration; }
-int get_maelstrom(shm_general_t *g){ return g->so_maelstrom; }
+double (get_lato)(shm_general_t *g){ return g->so_lato; }
+int (get_days)(shm_general_t *g){	return g->so_days; }
+int (get_navi)(shm_general_t *g){	return g->so_navi; }
+int (get_speed)(shm_general_t *g){ return g->so_speed; }
+int (get_capacity)(shm_general_t *g){ return g->so_capacity; }
+int (get_porti)(shm_general_t *g){ return g->so_porti; }
+int (get_banchine)(shm_general_t *g){ return g->so_banchine; }
+int (get_fill)(shm_general_t *g){	return g->so_fill; }
+int (get_load_speed)(shm_general_t *g){ return g->so_loadspeed; }
+int (get_merci)(shm_general_t *g){ return g->so_merci; }
+int (get_size)(shm_general_t *g){	return g->so_size; }
+int (get_min_vita)(shm_general_t *g){ return g->so_min_vita; }
+int (get_max_vita)(shm_general_t *g){ return g->so_max_vita; }
+int (get_storm_duration)(shm_general_t *g){ return g->so_storm_duration; }
+int (get_swell_duration)(shm_general_t *g){ return g->so_swell_duration; }
+int (get_maelstrom)(shm_general_t *g){ return g->so_maelstrom; }
+int (get_day_lag)(shm_general_t *g){ return g->so_day_lag; }
+int (get_dock_workers)(shm_general_t *g){ return g->so_dock_workers; }
+int (get_pipeline)(shm_general_t *g){ return g->so_pipeline; }
+int (get_sparse_max)(shm_general_t *g){ return g->so_sparse_max; }
+int (get_shards)(shm_general_t *g){ return g->so_shards; }
+
+/* Getters for derived constants */
+int (get_daily_fill)(shm_general_t *g){ return g->daily_fill; }
+int (get_port_types)(shm_general_t *g){ return g->port_types; }
+int (get_regions)(shm_general_t *g){ return g->regions; }
+double (get_inv_speed)(shm_general_t *g){ return g->inv_speed; }
+int get_size_min_id(shm_general_t *g){ return g->size_min_id; }
+int get_size_min(shm_general_t *g){ return g->size_min; }
+
+void set_size_min(shm_general_t *g, int id, int size)
+{
+	g->size_min_id = id;
+	g->size_min = size;
+}
+
+bool_t check_constants(shm_general_t *g)
+{
+#ifdef SO_SCENARIO
+	return g->so_lato == SO_LATO_VALUE && g->so_days == SO_DAYS_VALUE
+		&& g->so_navi == SO_NAVI_VALUE && g->so_speed == SO_SPEED_VALUE
+		&& g->so_capacity == SO_CAPACITY_VALUE && g->so_porti == SO_PORTI_VALUE
+		&& g->so_banchine == SO_BANCHINE_VALUE && g->so_fill == SO_FILL_VALUE
+		&& g->so_loadspeed == SO_LOADSPEED_VALUE && g->so_merci == SO_MERCI_VALUE
+		&& g->so_size == SO_SIZE_VALUE && g->so_min_vita == SO_MIN_VITA_VALUE
+		&& g->so_max_vita == SO_MAX_VITA_VALUE && g->so_storm_duration == SO_STORM_DURATION_VALUE
+		&& g->so_swell_duration == SO_SWELL_DURATION_VALUE && g->so_maelstrom == SO_MAELSTROM_VALUE
+		&& g->so_day_lag == SO_DAY_LAG_VALUE && g->so_dock_workers == SO_DOCK_WORKERS_VALUE
+		&& g->so_pipeline == SO_PIPELINE_VALUE && g->so_sparse_max == SO_SPARSE_MAX_VALUE
+		&& g->so_shards == SO_SHARDS_VALUE;
+#else
+	(void)g;
+	return TRUE;
+#endif
+}
 
 int get_current_day(shm_general_t *g){ return g->current_day; }
+unsigned long get_day_tick_ns(shm_general_t *g){ return g->day_tick_ns; }
 
-void increase_day(shm_general_t *g){ g->current_day++; }
+int get_checkpoint_day(shm_general_t *g){ return g->checkpoint_day; }
+const char *get_checkpoint_path(shm_general_t *g){ return g->checkpoint_path; }
+int get_restore_day(shm_general_t *g){ return g->restore_day; }
+const char *get_restore_path(shm_general_t *g){ return g->restore_path; }
+int get_checkpoint_phase(shm_general_t *g){ return g->checkpoint_phase; }
+int get_checkpoint_joined(shm_general_t *g){ return g->checkpoint_joined; }
+
+void set_checkpoint(shm_general_t *g, const char *path, int day)
+{
+	strcpy(g->checkpoint_path, path);
+	g->checkpoint_day = day;
+}
+
+void set_checkpoint_phase(shm_general_t *g, int phase)
+{
+	g->checkpoint_joined = 0;
+	__sync_synchronize();
+	g->checkpoint_phase = phase;
+}
+
+void add_checkpoint_joined(shm_general_t *g)
+{
+	__sync_fetch_and_add(&g->checkpoint_joined, 1);
+}
+
+void increase_day(shm_general_t *g)
+{
+	int i;
+
+	/* Every port has a new day to process before anyone waits on it */
+	for (i = 0; i < g->so_porti; i++)
+		sem_execute_semop(g->sem_epoch_id, i, 1, 0);
+	g->day_tick_ns = get_time_ns();
+	g->current_day++;
+}
 
 
 
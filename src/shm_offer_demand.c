@@ -1,10 +1,14 @@
 #define _GNU_SOURCE
 
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <stdio.h>
 
 #include "../lib/shm.h"
+#include "../lib/semaphore.h"
 
 #include "include/const.h"
 #include "include/utils.h"
@@ -12,21 +16,108 @@
 #include "include/shm_offer_demand.h"
 #include "include/cargo_list.h"
 
+/*
+ * Both segments store a row of get_port_types() entries per port, every
+ * entry carrying its cargo type. Dense rows hold every type in order; with
+ * SO_SPARSE_MAX each port trades a fixed set of types, sorted in the row,
+ * and the rows are followed by an inverted index listing the ports of every
+ * type (IDX_START[type] to IDX_START[type + 1] in IDX_PORTS).
+ */
+
 /**
  * @brief Macro to calculate the index in the shared memory array.
  */
 #define GET_INDEX(port_id,cargo_id,n_cargo) (port_id * n_cargo + cargo_id)
 
+#define IS_SPARSE(g) (get_port_types(g) < get_merci(g))
+#define IDX_START(e,g) ((int *)((e) + get_porti(g) * get_port_types(g)))
+#define IDX_PORTS(e,g) (IDX_START(e,g) + get_merci(g) + 1)
+#define IDX_SIZE(g) (IS_SPARSE(g) ? get_merci(g) + 1 + get_porti(g) * get_port_types(g) : 0)
+
+/**
+ * @brief Macro to get the reservation of a ship, stored after the demand
+ * 	rows: the port, the last day it is valid and the quantity by cargo type.
+ */
+#define GET_RESERVATION(d,g,ship_id) \
+	(IDX_START(d,g) + IDX_SIZE(g) + (ship_id) * (RES_QUANTITY + get_merci(g)))
+#define RES_PORT 0
+#define RES_EXPIRE 1
+#define RES_QUANTITY 2
+
+/**
+ * @brief Macros to get the port sets of a cargo type, stored last in the
+ * 	segment and aligned to a word: bit port of the set is on while the
+ * 	port has a nonzero offer (or demand) of the type.
+ */
+#define ALIGN_WORD(size) (((size) + sizeof(unsigned long) - 1) & ~(sizeof(unsigned long) - 1))
+#define OFFER_HEAD_SIZE(g) \
+	(sizeof(struct shm_offer) * get_porti(g) * get_port_types(g) + sizeof(int) * IDX_SIZE(g))
+#define DEMAND_HEAD_SIZE(g) (sizeof(struct shm_demand) * get_porti(g) * get_port_types(g) \
+	+ sizeof(int) * (IDX_SIZE(g) + get_navi(g) * (RES_QUANTITY + get_merci(g))))
+#define GET_OFFER_SET(o,g,type) ((unsigned long *)((char *)(o) + ALIGN_WORD(OFFER_HEAD_SIZE(g))) \
+	+ (type) * shm_offer_demand_get_set_words(g))
+#define GET_DEMAND_SET(d,g,type) ((unsigned long *)((char *)(d) + ALIGN_WORD(DEMAND_HEAD_SIZE(g))) \
+	+ (type) * shm_offer_demand_get_set_words(g))
+#define SETS_SIZE(g) (sizeof(unsigned long) * get_merci(g) * shm_offer_demand_get_set_words(g))
+
 struct shm_offer {
+	int type;
 	int data;
 	int dump_tot_offered;
 };
 
 struct shm_demand {
+	int type;
 	int data;
 	int dump_tot_demanded;
+	int reserved;	/* by the ships travelling to the port */
 };
 
+static int compare_int(const void *a, const void *b);
+static int find_entry(shm_general_t *g, const void *e, size_t size, int port_id, int cargo_id);
+static bool_t shm_offer_pattern_init(shm_general_t *g, shm_offer_t *o);
+static void port_set_update(unsigned long *set, int port_id, bool_t on);
+
+int shm_offer_demand_get_set_words(shm_general_t *g)
+{
+	return (get_porti(g) + PORT_SET_BITS - 1) / PORT_SET_BITS;
+}
+
+/**
+ * @brief Finds the entry of a cargo type in the row of a port.
+ * @param e The offer or the demand rows, whose entries start with their type.
+ * @param size Size of an entry.
+ * @return The index of the entry or -1 if the port does not trade the type.
+ */
+static int find_entry(shm_general_t *g, const void *e, size_t size, int port_id, int cargo_id)
+{
+	int index, type, n_row = get_port_types(g);
+
+	if (n_row == get_merci(g))
+		return GET_INDEX(port_id, cargo_id, n_row);
+	/* Sparse rows are sorted by type */
+	for (index = port_id * n_row; index < (port_id + 1) * n_row; index++) {
+		type = *(const int *)((const char *)e + index * size);
+		if (type >= cargo_id)
+			return type == cargo_id ? index : -1;
+	}
+	return -1;
+}
+
+/**
+ * @brief Turns the bit of a port on or off, the words are shared with the
+ * 	other ports so the update is atomic.
+ */
+static void port_set_update(unsigned long *set, int port_id, bool_t on)
+{
+	unsigned long bit = 1UL << (port_id % PORT_SET_BITS);
+
+	if (on)
+		__sync_fetch_and_or(&set[port_id / PORT_SET_BITS], bit);
+	else
+		__sync_fetch_and_and(&set[port_id / PORT_SET_BITS], ~bit);
+}
+
 /* OFFER SHM FUNCTIONS */
 
 shm_offer_t *shm_offer_init(shm_general_t *g)
@@ -35,20 +126,87 @@ shm_offer_t *shm_offer_init(shm_general_t *g)
 	size_t size;
 	shm_offer_t *offer;
 
-	size = (sizeof(struct shm_offer) * get_porti(g) * get_merci(g));
+	size = shm_offer_get_segment_size(g);
 
-	shm_id = shm_create(SHM_DATA_PORT_OFFER_KEY, size);
+	shm_id = shm_create(ipc_key(SHM_DATA_PORT_OFFER_KEY), size);
 	if (shm_id == -1) {
 		return NULL;
 	}
 
 	offer = shm_attach(shm_id);
 	bzero(offer, size);
+	if (!shm_offer_pattern_init(g, offer)) {
+		shm_detach(offer);
+		shm_delete(shm_id);
+		return NULL;
+	}
 	shm_offer_set_id(g, shm_id);
 
 	return offer;
 }
 
+size_t shm_offer_get_segment_size(shm_general_t *g)
+{
+	return ALIGN_WORD(OFFER_HEAD_SIZE(g)) + SETS_SIZE(g);
+}
+
+static int compare_int(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/**
+ * @brief Picks the cargo types of every port and builds the inverted index.
+ * @return FALSE if the memory could not be allocated, TRUE otherwise.
+ */
+static bool_t shm_offer_pattern_init(shm_general_t *g, shm_offer_t *o)
+{
+	int port, i, j, tmp, n_row, n_merci, *types, *start, *ports;
+
+	n_row = get_port_types(g);
+	n_merci = get_merci(g);
+	if (!IS_SPARSE(g)) {
+		for (i = 0; i < get_porti(g) * n_row; i++)
+			o[i].type = i % n_merci;
+		return TRUE;
+	}
+
+	types = malloc(sizeof(int) * n_merci);
+	if (types == NULL) {
+		dprintf(2, "shm_offer_demand.c: Failed to allocate the cargo types of the ports.\n");
+		return FALSE;
+	}
+	for (i = 0; i < n_merci; i++)
+		types[i] = i;
+	start = IDX_START(o, g);
+	for (port = 0; port < get_porti(g); port++) {
+		/* Partial Fisher-Yates: the first n_row types are a random subset */
+		for (i = 0; i < n_row; i++) {
+			j = RANDOM_INTEGER(i, n_merci - 1);
+			tmp = types[i];
+			types[i] = types[j];
+			types[j] = tmp;
+		}
+		qsort(types, n_row, sizeof(int), compare_int);
+		for (i = 0; i < n_row; i++) {
+			o[port * n_row + i].type = types[i];
+			start[types[i] + 1]++;
+		}
+	}
+	free(types);
+
+	for (i = 0; i < n_merci; i++)
+		start[i + 1] += start[i];
+	ports = IDX_PORTS(o, g);
+	for (i = 0; i < get_porti(g) * n_row; i++)
+		ports[start[o[i].type]++] = i / n_row;
+	/* Filling shifted every start to the next type */
+	for (i = n_merci; i > 0; i--)
+		start[i] = start[i - 1];
+	start[0] = 0;
+	return TRUE;
+}
+
 shm_offer_t *shm_offer_attach(shm_general_t *g)
 {
 	shm_offer_t *offer;
@@ -64,50 +222,87 @@ void shm_offer_detach(shm_offer_t *o)
 void shm_offer_remove_quantity(shm_offer_t *o, shm_general_t *g, int id, int type,
 		      int quantity)
 {
+	int index;
+
 	if (o == NULL || quantity == 0) {
 		return;
 	}
 
-	o[GET_INDEX(id, type, get_merci(g))].data -= quantity;
+	index = find_entry(g, o, sizeof(*o), id, type);
+	if (index < 0)
+		return;
+	o[index].data -= quantity;
+	/* A restore gives quantity back with a negative one */
+	if ((o[index].data > 0) != (o[index].data + quantity > 0))
+		port_set_update(GET_OFFER_SET(o, g, type), id, o[index].data > 0);
 }
 
 int shm_offer_get_quantity(shm_general_t *g, shm_offer_t *o, int port_id, int cargo_id)
 {
-	return o[GET_INDEX(port_id,cargo_id, get_merci(g))].data;
+	int index;
+	index = find_entry(g, o, sizeof(*o), port_id, cargo_id);
+	return index >= 0 ? o[index].data : 0;
 }
 
 int shm_offer_get_tot_quantity(shm_general_t *g, shm_offer_t *o, int port_id)
 {
 	int i, qty = 0;
-	int n_merci = get_merci(g);
-	for(i = 0; i < n_merci; i++) {
-		qty += o[GET_INDEX(port_id, i, n_merci)].data;
+	int n_row = get_port_types(g);
+	for(i = 0; i < n_row; i++) {
+		qty += o[GET_INDEX(port_id, i, n_row)].data;
 	}
 	return qty;
 }
 
+const unsigned long *shm_offer_get_port_set(shm_general_t *g, shm_offer_t *o, int cargo_id)
+{
+	return GET_OFFER_SET(o, g, cargo_id);
+}
+
+int shm_offer_get_row_type(shm_general_t *g, shm_offer_t *o, int port_id, int i)
+{
+	return o[GET_INDEX(port_id, i, get_port_types(g))].type;
+}
+
+int shm_offer_get_row_quantity(shm_general_t *g, shm_offer_t *o, int port_id, int i)
+{
+	return o[GET_INDEX(port_id, i, get_port_types(g))].data;
+}
+
 /* DEMAND SHM FUNCTIONS */
 
-shm_demand_t *shm_demand_init(shm_general_t *g)
+shm_demand_t *shm_demand_init(shm_general_t *g, shm_offer_t *o)
 {
 	int shm_id;
 	size_t size;
 	shm_demand_t *demand;
+	int i;
 
-	size = (sizeof(struct shm_offer) * get_porti(g) * get_merci(g));
+	size = shm_demand_get_segment_size(g);
 
-	shm_id = shm_create(SHM_DATA_DEMAND_KEY, size);
+	shm_id = shm_create(ipc_key(SHM_DATA_DEMAND_KEY), size);
 	if (shm_id == -1) {
 		return NULL;
 	}
 
 	demand = shm_attach(shm_id);
 	bzero(demand, size);
+	/* The demand mirrors the cargo types of the offer */
+	for (i = 0; i < get_porti(g) * get_port_types(g); i++)
+		demand[i].type = o[i].type;
+	memcpy(IDX_START(demand, g), IDX_START(o, g), sizeof(int) * IDX_SIZE(g));
+	for (i = 0; i < get_navi(g); i++)
+		GET_RESERVATION(demand, g, i)[RES_PORT] = -1;
 	shm_demand_set_id(g, shm_id);
 
 	return demand;
 }
 
+size_t shm_demand_get_segment_size(shm_general_t *g)
+{
+	return ALIGN_WORD(DEMAND_HEAD_SIZE(g)) + SETS_SIZE(g);
+}
+
 shm_demand_t *shm_demand_attach(shm_general_t *g)
 {
 	shm_demand_t *demands;
@@ -122,17 +317,124 @@ void shm_demand_detach(shm_demand_t *d)
 
 int shm_demand_get_quantity(shm_general_t *g, shm_demand_t *d, int port_id, int cargo_id)
 {
-	return d[GET_INDEX(port_id,cargo_id, get_merci(g))].data;
+	int index;
+	index = find_entry(g, d, sizeof(*d), port_id, cargo_id);
+	return index >= 0 ? d[index].data : 0;
 }
 
 void shm_demand_remove_quantity(shm_demand_t *d, shm_general_t *g, int id, int type,
 		       int quantity)
 {
+	int index;
+
 	if (d == NULL || quantity == 0) {
 		return;
 	}
 
-	d[GET_INDEX(id, type, get_merci(g))].data -= quantity;
+	index = find_entry(g, d, sizeof(*d), id, type);
+	if (index < 0)
+		return;
+	d[index].data -= quantity;
+	if ((d[index].data > 0) != (d[index].data + quantity > 0))
+		port_set_update(GET_DEMAND_SET(d, g, type), id, d[index].data > 0);
+}
+
+int shm_demand_get_available(shm_general_t *g, shm_demand_t *d, int port_id, int cargo_id)
+{
+	int index;
+	index = find_entry(g, d, sizeof(*d), port_id, cargo_id);
+	return index >= 0 ? MAX(d[index].data - d[index].reserved, 0) : 0;
+}
+
+const unsigned long *shm_demand_get_port_set(shm_general_t *g, shm_demand_t *d, int cargo_id)
+{
+	return GET_DEMAND_SET(d, g, cargo_id);
+}
+
+int shm_demand_get_row_type(shm_general_t *g, shm_demand_t *d, int port_id, int i)
+{
+	return d[GET_INDEX(port_id, i, get_port_types(g))].type;
+}
+
+int shm_demand_get_row_available(shm_general_t *g, shm_demand_t *d, int port_id, int i)
+{
+	int index = GET_INDEX(port_id, i, get_port_types(g));
+	return MAX(d[index].data - d[index].reserved, 0);
+}
+
+int shm_demand_get_reserved(shm_general_t *g, shm_demand_t *d, int ship_id, int port_id, int cargo_id)
+{
+	int *res = GET_RESERVATION(d, g, ship_id);
+	return res[RES_PORT] == port_id ? res[RES_QUANTITY + cargo_id] : 0;
+}
+
+/**
+ * @brief Gives the reserved quantities back to the demand of the port,
+ * 	the lock of the port must be held.
+ */
+static void shm_demand_release(shm_demand_t *d, shm_general_t *g, int *res)
+{
+	int i, type, n_row = get_port_types(g);
+
+	for (i = res[RES_PORT] * n_row; i < (res[RES_PORT] + 1) * n_row; i++) {
+		type = d[i].type;
+		d[i].reserved -= res[RES_QUANTITY + type];
+		res[RES_QUANTITY + type] = 0;
+	}
+	res[RES_PORT] = -1;
+}
+
+void shm_demand_reserve(shm_demand_t *d, shm_general_t *g, int ship_id, int port_id,
+			int *quantity, int expire_day)
+{
+	int *res = GET_RESERVATION(d, g, ship_id);
+	int i, type, n_row = get_port_types(g), sem_id = sem_reservation_get_id(g);
+
+	shm_demand_commit(d, g, ship_id);
+	for (i = port_id * n_row; i < (port_id + 1) * n_row && quantity[d[i].type] <= 0; i++);
+	if (i == (port_id + 1) * n_row)
+		return;
+
+	sem_execute_semop(sem_id, port_id, -1, SEM_UNDO);
+	res[RES_EXPIRE] = expire_day;
+	for (i = port_id * n_row; i < (port_id + 1) * n_row; i++) {
+		type = d[i].type;
+		res[RES_QUANTITY + type] = MAX(quantity[type], 0);
+		d[i].reserved += res[RES_QUANTITY + type];
+	}
+	res[RES_PORT] = port_id;
+	sem_execute_semop(sem_id, port_id, 1, SEM_UNDO);
+}
+
+int shm_demand_commit(shm_demand_t *d, shm_general_t *g, int ship_id)
+{
+	int *res = GET_RESERVATION(d, g, ship_id);
+	int port_id = res[RES_PORT], released = -1, sem_id = sem_reservation_get_id(g);
+
+	if (port_id < 0)
+		return -1;
+	sem_execute_semop(sem_id, port_id, -1, SEM_UNDO);
+	/* The port may have expired it in the meantime */
+	if (res[RES_PORT] == port_id) {
+		shm_demand_release(d, g, res);
+		released = port_id;
+	}
+	sem_execute_semop(sem_id, port_id, 1, SEM_UNDO);
+	return released;
+}
+
+void shm_demand_expire_reservations(shm_demand_t *d, shm_general_t *g, int port_id)
+{
+	int *res;
+	int ship_id, day = get_current_day(g), sem_id = sem_reservation_get_id(g);
+
+	sem_execute_semop(sem_id, port_id, -1, SEM_UNDO);
+	for (ship_id = 0; ship_id < get_navi(g); ship_id++) {
+		res = GET_RESERVATION(d, g, ship_id);
+		if (res[RES_PORT] == port_id && res[RES_EXPIRE] < day)
+			shm_demand_release(d, g, res);
+	}
+	sem_execute_semop(sem_id, port_id, 1, SEM_UNDO);
 }
 
 /* OFFER AND DEMAND SHM FUNCTIONS */
@@ -143,94 +445,105 @@ void shm_offer_demand_delete(shm_general_t *g)
 	shm_delete(shm_demand_get_id(g));
 }
 
+/**
+ * @brief Adds quantity lots to the demand or to the offer of an entry of the
+ * 	port, an empty entry picks one of the two at random.
+ */
+static void shm_offer_demand_add(shm_offer_t *o, shm_demand_t *d, o_list_t **l,
+				 shm_cargo_t *c, shm_general_t *g, int index, int quantity)
+{
+	int type = o[index].type;
+
+	if (d[index].data > 0 || (o[index].data == 0 && RANDOM_BOOL() == FALSE)) {
+		d[index].data += quantity;
+		d[index].dump_tot_demanded += quantity;
+		/* The words are shared, touch them only when the entry crosses zero */
+		if (d[index].data > 0 && d[index].data - quantity <= 0)
+			port_set_update(GET_DEMAND_SET(d, g, type), index / get_port_types(g), TRUE);
+		return;
+	}
+	o[index].data += quantity;
+	o[index].dump_tot_offered += quantity;
+	if (o[index].data > 0 && o[index].data - quantity <= 0)
+		port_set_update(GET_OFFER_SET(o, g, type), index / get_port_types(g), TRUE);
+	cargo_list_add(l[type], quantity, shm_cargo_get_life(c, type) + get_current_day(g));
+	shm_cargo_update_dump_generated(c, type, quantity, sem_cargo_get_id(g));
+}
+
 void shm_offer_demand_generate(shm_offer_t *o, shm_demand_t *d, o_list_t **l,
 			       int port_id, shm_cargo_t *c, shm_general_t *g)
 {
-	bool_t filled;
-	int random_quantity, random_id, expiration;
-	int n_merci, size, fill, current_fill, index, i, cur_id;
-	int id_min, size_min;
-	int sem_cargo_id = sem_cargo_get_id(g);
+	int n_row, first, i, index, size, tons, quantity, rest, min_index;
 
 	if (o == NULL || d == NULL || l == NULL || c == NULL) {
 		return;
 	}
 
-	fill = get_fill(g) / get_days(g);
-	current_fill = fill;
-	n_merci = get_merci(g);
-	id_min = shm_cargo_get_min_size_id(c, g);
-	size_min = shm_cargo_get_size(c, id_min);
-
-	while (current_fill > 0) {
-		filled = TRUE;
-		random_id = RANDOM_INTEGER(0, n_merci - 1);
-		random_quantity = (RANDOM_INTEGER(1, current_fill));
-		size = shm_cargo_get_size(c, random_id);
-
-		if ((random_quantity * size) > current_fill) {
-			for (i = 0; i < n_merci; i++) {
-				cur_id = (random_id + i + 1) % n_merci;
-				size = shm_cargo_get_size(c, cur_id);
-				random_quantity = (RANDOM_INTEGER(1, current_fill));
-
-				if (((random_quantity * size) >= current_fill && (current_fill >= size))) {
-					random_quantity = RANDOM_INTEGER(1, current_fill / size);
-					random_id = cur_id;
-					filled = TRUE;
-					break;
-				}
-				filled = FALSE;
-			}
-
-			if (filled == FALSE) {
-				if (size <= current_fill) {
-					random_quantity = current_fill / size_min;
-					random_id = id_min;
-				} else {
-					break;
-				}
-			}
-		}
-
-		expiration = shm_cargo_get_life(c, random_id);
-		index = GET_INDEX(port_id, random_id, n_merci);
-
-		if (d[index].data > 0) {
-			d[index].data += random_quantity;
-			d[index].dump_tot_demanded += random_quantity;
-		} else if (o[index].data > 0) {
-			o[index].data += random_quantity;
-			o[index].dump_tot_offered += random_quantity;
-			cargo_list_add(l[random_id], random_quantity, expiration + get_current_day(g));
-			shm_cargo_update_dump_available_in_port(c, random_id, random_quantity, sem_cargo_id);
-			shm_cargo_update_dump_total_generated(c, random_id, random_quantity, sem_cargo_id);
-		} else {
-			if (RANDOM_BOOL() == TRUE) {
-				o[index].data = random_quantity;
-				o[index].dump_tot_offered += random_quantity;
-				cargo_list_add(l[random_id],random_quantity, expiration + get_current_day(g));
-				shm_cargo_update_dump_available_in_port(c, random_id, random_quantity, sem_cargo_id);
-				shm_cargo_update_dump_total_generated(c, random_id, random_quantity, sem_cargo_id);
-			} else {
-				d[index].dump_tot_demanded += random_quantity;
-				d[index].data = random_quantity;
-			}
+	n_row = get_port_types(g);
+	rest = get_daily_fill(g);
+	first = RANDOM_INTEGER(0, n_row - 1);
+
+	/*
+	 * Stick-breaking: every type takes a Beta(1, types left - 1) share of
+	 * the tons left, so the fill is split uniformly among the types in a
+	 * single pass. The tons too few for a batch go to the smallest batch.
+	 */
+	for (i = 0; i < n_row && rest > 0; i++) {
+		index = GET_INDEX(port_id, (first + i) % n_row, n_row);
+		size = shm_cargo_get_size(c, o[index].type);
+		if (i == n_row - 1)
+			tons = rest;
+		else
+			tons = (int)(rest * (1 - pow(RANDOM_DOUBLE(0, 1), 1.0 / (n_row - i - 1))));
+
+		quantity = tons / size;
+		if (quantity > 0) {
+			shm_offer_demand_add(o, d, l, c, g, index, quantity);
+			rest -= quantity * size;
 		}
+	}
+	if (IS_SPARSE(g)) {
+		min_index = GET_INDEX(port_id, 0, n_row);
+		for (index = min_index + 1; index < GET_INDEX(port_id, n_row, n_row); index++)
+			if (shm_cargo_get_size(c, o[index].type) < shm_cargo_get_size(c, o[min_index].type))
+				min_index = index;
+	} else {
+		min_index = GET_INDEX(port_id, get_size_min_id(g), n_row);
+	}
+	size = shm_cargo_get_size(c, o[min_index].type);
+	if (rest >= size)
+		shm_offer_demand_add(o, d, l, c, g, min_index, rest / size);
+}
 
-		current_fill -= random_quantity * size;
+/**
+ * @brief Gets the ports that trade a cargo type from the inverted index.
+ * @param start IDX_START() of the segment.
+ * @param ports Where the ports are stored, NULL for dense rows.
+ * @return The number of ports, every port for dense rows.
+ */
+static int get_ports(shm_general_t *g, int *start, int cargo_type, int **ports)
+{
+	if (!IS_SPARSE(g)) {
+		*ports = NULL;
+		return get_porti(g);
 	}
+	*ports = start + get_merci(g) + 1 + start[cargo_type];
+	return start[cargo_type + 1] - start[cargo_type];
 }
 
 int shm_offer_get_dump_highest(shm_general_t *g, shm_offer_t *o, int cargo_type)
 {
-	int i, n_cargo, tmp, max = -1, max_id = -1;
-	n_cargo = get_merci(g);
-	for (i = 0; i < get_porti(g); i++) {
-		tmp = o[GET_INDEX(i, cargo_type, n_cargo)].dump_tot_offered;
+	int i, n_ports, port, index, tmp, max = -1, max_id = -1;
+	int *ports;
+
+	n_ports = get_ports(g, IDX_START(o, g), cargo_type, &ports);
+	for (i = 0; i < n_ports; i++) {
+		port = ports != NULL ? ports[i] : i;
+		index = find_entry(g, o, sizeof(*o), port, cargo_type);
+		tmp = o[index].dump_tot_offered;
 		if (tmp > max) {
 			max = tmp;
-			max_id = i;
+			max_id = port;
 		}
 	}
 	return max_id;
@@ -238,13 +551,17 @@ int shm_offer_get_dump_highest(shm_general_t *g, shm_offer_t *o, int cargo_type)
 
 int shm_demand_get_dump_highest(shm_general_t *g, shm_demand_t *d, int cargo_type)
 {
-	int i, n_cargo, tmp, max = -1, max_id = -1;
-	n_cargo = get_merci(g);
-	for (i = 0; i < get_porti(g); i++) {
-		tmp = d[GET_INDEX(i, cargo_type, n_cargo)].dump_tot_demanded;
+	int i, n_ports, port, index, tmp, max = -1, max_id = -1;
+	int *ports;
+
+	n_ports = get_ports(g, IDX_START(d, g), cargo_type, &ports);
+	for (i = 0; i < n_ports; i++) {
+		port = ports != NULL ? ports[i] : i;
+		index = find_entry(g, d, sizeof(*d), port, cargo_type);
+		tmp = d[index].dump_tot_demanded;
 		if (tmp > max) {
 			max = tmp;
-			max_id = i;
+			max_id = port;
 		}
 	}
 	return max_id;
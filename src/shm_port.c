@@ -3,6 +3,7 @@
 #include <string.h>
 #include <signal.h>
 #include <stdio.h>
+#include <sched.h>
 
 #include "../lib/shm.h"
 #include "../lib/semaphore.h"
@@ -14,6 +15,8 @@
 #include "include/shm_port.h"
 
 struct shm_port {
+	/* Odd while the port updates its coordinates or its market row */
+	volatile unsigned int seq;
 	pid_t pid;
 	struct coord coord;
 	int num_docks;
@@ -25,8 +28,15 @@ struct shm_port {
 	int dump_cargo_shipped;
 	int dump_cargo_received;
 	int sem_docks_id;
+
+	int processed_day;	/* last day the offer and demand were generated for */
+
+	int queue;		/* ships waiting for a dock or docked */
+	double service_days;	/* moving average of the time a ship keeps a dock */
 };
 
+#define SERVICE_ALPHA 0.125	/* weight of the last ship in service_days */
+
 /* Ports shared memory */
 shm_port_t *shm_port_initialize(shm_general_t *g)
 {
@@ -34,9 +44,9 @@ shm_port_t *shm_port_initialize(shm_general_t *g)
 	int shm_id;
 	size_t size;
 
-	size = sizeof(struct shm_port) * get_porti(g);
+	size = shm_port_get_segment_size(g);
 
-	shm_id = shm_create(SHM_DATA_PORTS_KEY, size);
+	shm_id = shm_create(ipc_key(SHM_DATA_PORTS_KEY), size);
 	if (shm_id == -1) {
 		return NULL;
 	}
@@ -48,20 +58,50 @@ shm_port_t *shm_port_initialize(shm_general_t *g)
 	return ports;
 }
 
-void shm_port_ipc_init(shm_general_t *g, shm_port_t *p)
+size_t shm_port_get_segment_size(shm_general_t *g)
+{
+	return sizeof(struct shm_port) * get_porti(g);
+}
+
+bool_t shm_port_ipc_init(shm_general_t *g, shm_port_t *p)
 {
 	int i, n_ports, n_docks, rand_docks, sem_docks_id;
 	n_ports = get_porti(g);
 	n_docks = get_banchine(g);
 
 	/* Semaphores */
-	sem_docks_id = sem_create(SEM_DOCK_KEY, n_ports);
+	sem_docks_id = ipc_sem_create(SEM_DOCK_KEY, n_ports);
+	if (sem_docks_id == -1)
+		return FALSE;
 	for (i = 0; i < n_ports; i++) {
 		p[i].sem_docks_id = sem_docks_id;
 		rand_docks = RANDOM_INTEGER(1,n_docks);
 		sem_setval(p[i].sem_docks_id, i, rand_docks);
 		p[i].num_docks = rand_docks;
+		/* Day 0 is pending in the day barrier */
+		p[i].processed_day = -1;
+	}
+	return TRUE;
+}
+
+bool_t shm_port_ipc_restore(shm_general_t *g, shm_port_t *p)
+{
+	int i, n_ports, sem_docks_id;
+	n_ports = get_porti(g);
+
+	sem_docks_id = ipc_sem_create(SEM_DOCK_KEY, n_ports);
+	if (sem_docks_id == -1)
+		return FALSE;
+	for (i = 0; i < n_ports; i++) {
+		p[i].sem_docks_id = sem_docks_id;
+		sem_setval(sem_docks_id, i, p[i].num_docks);
+		p[i].processed_day = get_current_day(g) - 1;
+		/* The snapshot may have been taken in the middle of an update */
+		p[i].seq = 0;
+		/* Ships restart at sea */
+		p[i].queue = 0;
 	}
+	return TRUE;
 }
 
 shm_port_t *shm_port_attach(shm_general_t *g)
@@ -109,8 +149,92 @@ void shm_port_update_dump_cargo_available(shm_general_t *g, shm_port_t *p, shm_o
 void shm_port_update_dump_cargo_shipped(shm_port_t *p, int port_id, int amount){p[port_id].dump_cargo_shipped += amount;}
 void shm_port_update_dump_cargo_received(shm_port_t *p, int port_id, int amount){p[port_id].dump_cargo_received += amount;}
 
+void shm_port_write_begin(shm_port_t *p, int port_id)
+{
+	/* Atomic, the ships bump the counter too, see shm_port_market_changed() */
+	__sync_fetch_and_add(&p[port_id].seq, 1);
+}
+
+void shm_port_write_end(shm_port_t *p, int port_id)
+{
+	__sync_fetch_and_add(&p[port_id].seq, 1);
+}
+
+void shm_port_market_changed(shm_port_t *p, int port_id)
+{
+	__sync_fetch_and_add(&p[port_id].seq, 2);
+}
+
+unsigned int shm_port_read_begin(shm_port_t *p, int port_id)
+{
+	unsigned int seq;
+
+	while ((seq = p[port_id].seq) & 1)
+		sched_yield();
+	__sync_synchronize();
+	return seq;
+}
+
+bool_t shm_port_read_retry(shm_port_t *p, int port_id, unsigned int seq)
+{
+	__sync_synchronize();
+	return p[port_id].seq != seq;
+}
+
+void shm_port_publish_day(shm_general_t *g, shm_port_t *p, int port_id, int day)
+{
+	/* A port that skipped days releases all of them */
+	sem_execute_semop(sem_epoch_get_id(g), port_id, p[port_id].processed_day - day, 0);
+	p[port_id].processed_day = day;
+}
+
+void shm_port_wait_day(shm_general_t *g, shm_port_t *p, int port_id)
+{
+	int lag = get_day_lag(g);
+
+	/* Only this port is waited for, the others may lag behind */
+	if (lag >= 0 && get_current_day(g) - p[port_id].processed_day > lag)
+		sem_execute_semop(sem_epoch_get_id(g), port_id, 0, 0);
+}
+
+void shm_port_enter_queue(shm_port_t *p, int port_id)
+{
+	__sync_fetch_and_add(&p[port_id].queue, 1);
+}
+
+void shm_port_leave_queue(shm_port_t *p, int port_id, double service_days)
+{
+	__sync_fetch_and_sub(&p[port_id].queue, 1);
+	/* Concurrent updates may be lost, it's only an estimate */
+	if (service_days >= 0)
+		p[port_id].service_days += SERVICE_ALPHA * (service_days - p[port_id].service_days);
+}
+
 /* Getters */
-struct coord shm_port_get_coordinates(shm_port_t *p, int port_id){return p[port_id].coord;}
+double shm_port_get_expected_wait(shm_port_t *p, int port_id, double travel_time)
+{
+	double wait;
+
+	/* The ships ahead are served num_docks at a time, and keep being served while travelling */
+	wait = (p[port_id].queue + 1 - p[port_id].num_docks) * p[port_id].service_days / p[port_id].num_docks;
+	return MAX(wait - travel_time, 0);
+}
+
+int shm_port_get_queue(shm_port_t *p, int port_id){return p[port_id].queue;}
+double shm_port_get_service_days(shm_port_t *p, int port_id){return p[port_id].service_days;}
+
+struct coord shm_port_get_coordinates(shm_port_t *p, int port_id)
+{
+	struct coord coord;
+	unsigned int seq;
+
+	do {
+		seq = shm_port_read_begin(p, port_id);
+		coord = p[port_id].coord;
+	} while (shm_port_read_retry(p, port_id, seq));
+	return coord;
+}
+
 int shm_port_get_docks(shm_port_t *p, int port_id){return p[port_id].num_docks;}
 int shm_port_get_sem_docks_id(shm_port_t *p){return p->sem_docks_id;}
 int shm_port_get_dump_used_docks(shm_port_t *p, int port_id){return p[port_id].num_docks - sem_getval(p->sem_docks_id, port_id);}
@@ -133,15 +257,17 @@ int shm_port_get_dump_cargo_received(shm_port_t *p, int port_id){return p[port_i
 
 void shm_port_remove_expired(shm_general_t *g, shm_port_t *p, shm_offer_t *o, shm_cargo_t *c, o_list_t **cargo_hold, int port_id)
 {
-	int i, removed, sem_cargo_id;
+	int i, type, removed, sem_cargo_id;
 	sem_cargo_id = sem_cargo_get_id(g);
 
-	for (i = 0; i < get_merci(g); i++) {
-		removed = cargo_list_remove_expired(cargo_hold[i], get_current_day(g));
+	/* The port holds only the types of its row */
+	for (i = 0; i < get_port_types(g); i++) {
+		type = shm_offer_get_row_type(g, o, port_id, i);
+		removed = cargo_list_remove_expired(cargo_hold[type], get_current_day(g));
 		if (removed > 0){
-			shm_offer_remove_quantity(o, g, port_id, i, removed);
-			shm_cargo_update_dump_available_in_port(c, i, -removed, sem_cargo_id);
-			shm_cargo_update_dump_expired_in_port(c, i, removed, sem_cargo_id);
+			shm_offer_remove_quantity(o, g, port_id, type, removed);
+			shm_cargo_update_dump_available_in_port(c, type, -removed, sem_cargo_id);
+			shm_cargo_update_dump_expired_in_port(c, type, removed, sem_cargo_id);
 		}
 	}
 }
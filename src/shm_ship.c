@@ -4,6 +4,7 @@
 #include <string.h>
 #include <signal.h>
 #include <stdio.h>
+#include <limits.h>
 
 #include "../lib/shm.h"
 
@@ -33,9 +34,9 @@ shm_ship_t *shm_ship_initialize(shm_general_t *g)
 	size_t size;
 
 	n_ships = get_navi(g);
-	size = sizeof(struct shm_ship) * n_ships;
+	size = shm_ship_get_segment_size(g);
 
-	id = shm_create(SHM_DATA_SHIPS_KEY, size);
+	id = shm_create(ipc_key(SHM_DATA_SHIPS_KEY), size);
 	if (id == -1) {
 		return NULL;
 	}
@@ -49,6 +50,11 @@ shm_ship_t *shm_ship_initialize(shm_general_t *g)
 	return ships;
 }
 
+size_t shm_ship_get_segment_size(shm_general_t *g)
+{
+	return sizeof(struct shm_ship) * get_navi(g);
+}
+
 shm_ship_t *shm_ship_attach(shm_general_t *g)
 {
 	shm_ship_t *ships;
@@ -158,18 +164,20 @@ int shm_ship_get_dump_is_dead(shm_ship_t *s, int n_ships)
 
 void shm_ship_update_capacity(shm_ship_t *s, int ship_id, int update_value){s[ship_id].capacity += update_value;}
 
-void shm_ship_remove_expired(shm_general_t *g, shm_ship_t *s, shm_cargo_t *c, o_list_t **cargo_hold, int ship_id)
+int shm_ship_remove_expired(shm_general_t *g, shm_ship_t *s, shm_cargo_t *c, o_list_t **cargo_hold, int ship_id)
 {
-	int i, removed, sem_cargo_id;
+	int i, removed, sem_cargo_id, next_expire = INT_MAX;
 	sem_cargo_id = sem_cargo_get_id(g);
 	for (i = 0; i < get_merci(g); i++) {
 		removed = cargo_list_remove_expired(cargo_hold[i], get_current_day(g));
 		if (removed > 0) {
-			s[ship_id].capacity -= removed * shm_cargo_get_size(c, i);
+			s[ship_id].capacity += removed * shm_cargo_get_size(c, i);
 			shm_cargo_update_dump_available_on_ship(c, i, -removed, sem_cargo_id);
 			shm_cargo_update_dump_expired_on_ship(c, i, removed, sem_cargo_id);
 		}
+		next_expire = MIN(next_expire, cargo_list_get_first_expire(cargo_hold[i]));
 	}
+	return next_expire;
 }
 
 void shm_ship_remove_cargo_maelstrom(shm_general_t *g, shm_ship_t *s, shm_cargo_t *c, o_list_t **cargo_hold, int ship_id)
@@ -0,0 +1,113 @@
+#define _GNU_SOURCE
+
+#include <string.h>
+
+#include "../lib/shm.h"
+#include "../lib/histogram.h"
+
+#include "include/const.h"
+#include "include/utils.h"
+#include "include/shm_general.h"
+#include "include/shm_stats.h"
+
+struct shm_stats {
+	struct histogram latency[LAT_NUM];
+	unsigned long counters[CNT_NUM];
+};
+
+static const char *latency_names[LAT_NUM] = {
+	"sell round trip",
+	"buy round trip",
+	"dock wait",
+	"port response",
+	"day reaction",
+	"day fan-out"
+};
+
+/**
+ * @brief Gets the number of slots: one per port, one per ship and one for the master.
+ * @param g Pointer to the general shared memory structure.
+ * @return The number of slots.
+ */
+static int shm_stats_get_slots(shm_general_t *g)
+{
+	return get_porti(g) + get_navi(g) + 1;
+}
+
+shm_stats_t *shm_stats_initialize(shm_general_t *g)
+{
+	shm_stats_t *stats;
+	int shm_id;
+	size_t size;
+
+	size = sizeof(struct shm_stats) * shm_stats_get_slots(g);
+
+	shm_id = shm_create(ipc_key(SHM_DATA_STATS_KEY), size);
+	if (shm_id == -1) {
+		return NULL;
+	}
+
+	stats = shm_attach(shm_id);
+	bzero(stats, size);
+	shm_stats_set_id(g, shm_id);
+
+	return stats;
+}
+
+shm_stats_t *shm_stats_attach(shm_general_t *g)
+{
+	shm_stats_t *stats;
+	stats = shm_attach(shm_stats_get_id(g));
+	return stats;
+}
+
+void shm_stats_detach(shm_stats_t *s) { shm_detach(s); }
+
+void shm_stats_delete(shm_general_t *g) { shm_delete(shm_stats_get_id(g)); }
+
+/* Slots */
+int shm_stats_port_slot(int port_id) { return port_id; }
+int shm_stats_ship_slot(shm_general_t *g, int ship_id) { return get_porti(g) + ship_id; }
+int shm_stats_master_slot(shm_general_t *g) { return get_porti(g) + get_navi(g); }
+
+void shm_stats_record_since(shm_stats_t *s, int slot, enum latency type, unsigned long start_ns)
+{
+	if (s == NULL)
+		return;
+	histogram_record(&s[slot].latency[type], get_time_ns() - start_ns);
+}
+
+void shm_stats_count(shm_stats_t *s, int slot, enum counter type, unsigned long value)
+{
+	if (s == NULL)
+		return;
+	s[slot].counters[type] += value;
+}
+
+unsigned long shm_stats_get_count(shm_stats_t *s, int slot, enum counter type)
+{
+	return s[slot].counters[type];
+}
+
+unsigned long shm_stats_get_total(shm_general_t *g, shm_stats_t *s, enum counter type)
+{
+	int i, n_slots;
+	unsigned long total = 0;
+
+	n_slots = shm_stats_get_slots(g);
+	for (i = 0; i < n_slots; i++)
+		total += s[i].counters[type];
+	return total;
+}
+
+void shm_stats_merge(shm_general_t *g, shm_stats_t *s, enum latency type, struct histogram *out)
+{
+	int i, n_slots;
+
+	histogram_reset(out);
+	n_slots = shm_stats_get_slots(g);
+	for (i = 0; i < n_slots; i++)
+		histogram_merge(out, &s[i].latency[type]);
+}
+
+const char *shm_stats_get_name(enum latency type) { return latency_names[type]; }
@@ -0,0 +1,104 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/shm_general.h"
+#include "include/sweep.h"
+
+static bool_t sweep_parse_param(struct sweep *s, char *param);
+
+bool_t sweep_parse(struct sweep *s, const char *grid)
+{
+	char *copy, *param, *save;
+	bool_t res = TRUE;
+
+	bzero(s, sizeof(*s));
+	copy = strdup(grid);
+	if (copy == NULL) {
+		return FALSE;
+	}
+
+	for (param = strtok_r(copy, " ;", &save); param != NULL && res == TRUE;
+	     param = strtok_r(NULL, " ;", &save))
+		res = sweep_parse_param(s, param);
+	free(copy);
+
+	return res == TRUE && s->n_params > 0;
+}
+
+int sweep_get_variants(struct sweep *s)
+{
+	int i, n = 1;
+
+	for (i = 0; i < s->n_params; i++)
+		n *= s->n_values[i];
+	return n;
+}
+
+void sweep_apply(struct sweep *s, int variant, shm_general_t *g)
+{
+	int i;
+
+	for (i = s->n_params - 1; i >= 0; i--) {
+		set_constant(g, s->index[i], s->values[i][variant % s->n_values[i]]);
+		variant /= s->n_values[i];
+	}
+}
+
+void sweep_describe(struct sweep *s, int variant, char *buf, size_t size)
+{
+	int i, values[SWEEP_MAX_PARAMS];
+	size_t len = 0;
+
+	for (i = s->n_params - 1; i >= 0; i--) {
+		values[i] = variant % s->n_values[i];
+		variant /= s->n_values[i];
+	}
+
+	buf[0] = '\0';
+	for (i = 0; i < s->n_params && len < size; i++)
+		len += snprintf(buf + len, size - len, "%s%s=%g", i > 0 ? " " : "",
+				s->names[i], s->values[i][values[i]]);
+}
+
+/**
+ * @brief Parses a single "NAME=v1,v2,..." parameter.
+ */
+static bool_t sweep_parse_param(struct sweep *s, char *param)
+{
+	char *value, *save, *end;
+	int n;
+
+	value = strchr(param, '=');
+	if (value == NULL || s->n_params >= SWEEP_MAX_PARAMS) {
+		return FALSE;
+	}
+	*value++ = '\0';
+
+	n = s->n_params;
+	s->index[n] = get_constant_index(param);
+	if (s->index[n] == -1 || strlen(param) >= SWEEP_NAME_LEN) {
+		dprintf(2, "sweep.c: Unknown constant %s.\n", param);
+		return FALSE;
+	}
+	strcpy(s->names[n], param);
+
+	for (value = strtok_r(value, ",", &save); value != NULL; value = strtok_r(NULL, ",", &save)) {
+		if (s->n_values[n] >= SWEEP_MAX_VALUES) {
+			return FALSE;
+		}
+		s->values[n][s->n_values[n]] = strtod(value, &end);
+		if (*end != '\0' || s->values[n][s->n_values[n]] < 0) {
+			dprintf(2, "sweep.c: Invalid value %s for %s.\n", value, param);
+			return FALSE;
+		}
+		s->n_values[n]++;
+	}
+	if (s->n_values[n] == 0) {
+		return FALSE;
+	}
+	s->n_params++;
+	return TRUE;
+}
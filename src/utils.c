@@ -3,7 +3,13 @@
 #include <time.h>
 #include <errno.h>
 
+#include "../lib/semaphore.h"
+
 #include "include/utils.h"
+#include "include/const.h"
+
+static int ipc_namespace;
+static bool_t ipc_reuse;
 
 static struct timespec get_timespec(double time_required)
 {
@@ -15,6 +21,11 @@ static struct timespec get_timespec(double time_required)
 }
 
 void convert_and_sleep(double time_required)
+{
+	convert_and_sleep_interruptible(time_required, NULL);
+}
+
+void convert_and_sleep_interruptible(double time_required, void (*on_interrupt)(void))
 {
 	struct timespec sleep_time, remaining_time;
 
@@ -26,5 +37,74 @@ void convert_and_sleep(double time_required)
 		errno = EXIT_SUCCESS;
 		nanosleep(&sleep_time, &remaining_time);
 		sleep_time = remaining_time;
+		if (errno == EINTR && on_interrupt != NULL) {
+			on_interrupt();
+			errno = EINTR;
+		}
 	} while (errno == EINTR);
 }
+
+unsigned long get_time_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long)now.tv_sec * 1000000000UL + (unsigned long)now.tv_nsec;
+}
+
+void ipc_set_namespace(int ns)
+{
+	ipc_namespace = ns & IPC_NS_MASK;
+}
+
+int ipc_get_namespace(void)
+{
+	return ipc_namespace;
+}
+
+int ipc_claim_namespace(int ns, int tries)
+{
+	int i;
+
+	for (i = 0; i < tries; i++, ns++) {
+		if ((ns & IPC_NS_MASK) == 0)
+			continue;
+		if (semget(SEM_NAMESPACE_KEY ^ (ns & IPC_NS_MASK), 1, 0600 | IPC_CREAT | IPC_EXCL) != -1)
+			return ns & IPC_NS_MASK;
+	}
+	return -1;
+}
+
+void ipc_release_namespace(int ns)
+{
+	int id;
+
+	if ((id = semget(SEM_NAMESPACE_KEY ^ (ns & IPC_NS_MASK), 0, 0)) != -1)
+		sem_delete(id);
+}
+
+void ipc_set_reuse(bool_t reuse)
+{
+	ipc_reuse = reuse;
+}
+
+bool_t ipc_get_reuse(void)
+{
+	return ipc_reuse;
+}
+
+int ipc_sem_create(key_t base, int nsems)
+{
+	if (ipc_reuse)
+		return sem_reuse(ipc_key(base), nsems);
+	return sem_create(ipc_key(base), nsems);
+}
+
+/*
+ * Keys in const.h differ in the bits above IPC_NS_MASK,
+ * so keys of different objects never collide.
+ */
+key_t ipc_key(key_t base)
+{
+	return base ^ ipc_namespace;
+}
@@ -38,6 +38,7 @@ int main(int argc, char *argv[])
 {
 	signal_handler_init();
 
+	ipc_set_namespace((int)strtol(argv[2], NULL, 10));
 	shm_general_attach(&state.general);
 	state.ports = shm_port_attach(state.general);
 	state.ships = shm_ship_attach(state.general);
@@ -58,6 +59,8 @@ void signal_handler_init(void)
 	struct sigaction sa;
 	bzero(&sa, sizeof(sa));
 	sa.sa_handler = &signal_handler;
+	/* The timer must not fire while close_all() detaches the segments */
+	sigfillset(&sa.sa_mask);
 
 	/* Signal handler initialization */
 	sigaction(SIGINT, &sa, NULL);
@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/include/shm_general.h"
+#include "../src/include/utils.h"
+#include "Unity/unity.h"
+
+#define REQUIRED \
+	"SO_LATO=1000.0\nSO_DAYS=3\nSO_NAVI=10\nSO_SPEED=500\nSO_CAPACITY=10\n" \
+	"SO_PORTI=4\nSO_BANCHINE=2\nSO_FILL=1000\nSO_LOADSPEED=200\nSO_MERCI=10\n" \
+	"SO_SIZE=1\nSO_MIN_VITA=3\nSO_MAX_VITA=10\nSO_STORM_DURATION=6\n" \
+	"SO_SWELL_DURATION=24\nSO_MAELSTROM=1\n"
+
+shm_general_t *g;
+
+/**
+ * @brief Reads a configuration written in a temporary file.
+ */
+shm_general_t *read_config(const char *text)
+{
+	char path[] = "/tmp/test_configXXXXXX";
+	shm_general_t *res;
+	int fd;
+
+	fd = mkstemp(path);
+	TEST_ASSERT_NOT_EQUAL(-1, fd);
+	TEST_ASSERT_EQUAL_INT((int)strlen(text), (int)write(fd, text, strlen(text)));
+	close(fd);
+	res = read_from_path(path, &g);
+	unlink(path);
+	return res;
+}
+
+void setUp(void)
+{
+	g = NULL;
+}
+
+void tearDown(void)
+{
+	if (g != NULL)
+		shm_general_delete(shm_general_get_id(g));
+}
+
+void test_optional_defaults(void)
+{
+	TEST_ASSERT_NOT_NULL(read_config(REQUIRED));
+	TEST_ASSERT_EQUAL_INT(-1, get_day_lag(g));
+	TEST_ASSERT_EQUAL_INT(0, get_dock_workers(g));
+	TEST_ASSERT_EQUAL_INT(0, get_pipeline(g));
+	TEST_ASSERT_EQUAL_INT(10, get_port_types(g));
+	TEST_ASSERT_EQUAL_INT(1, get_regions(g));
+}
+
+void test_keys_any_order(void)
+{
+	TEST_ASSERT_NOT_NULL(read_config("SO_SHARDS=2 # four regions\n  SO_SPARSE_MAX = 3\n" REQUIRED "SO_DAY_LAG=0\n"));
+	TEST_ASSERT_EQUAL_INT(0, get_day_lag(g));
+	TEST_ASSERT_EQUAL_INT(3, get_port_types(g));
+	TEST_ASSERT_EQUAL_INT(4, get_regions(g));
+	TEST_ASSERT_EQUAL_INT(1000 / 3, get_daily_fill(g));
+	TEST_ASSERT_EQUAL_DOUBLE(1000.0, get_lato(g));
+}
+
+void test_positional_values(void)
+{
+	TEST_ASSERT_NOT_NULL(read_config("1000.0\n3\n10\n500\n10\n4\n2\n1000\n200\n10\n1\n3\n10\n6\n24\n1\n"));
+	TEST_ASSERT_EQUAL_INT(4, get_porti(g));
+	TEST_ASSERT_EQUAL_INT(-1, get_day_lag(g));
+}
+
+void test_required_out_of_range(void)
+{
+	/* REQUIRED sets SO_PORTI again, but the first line already fails */
+	TEST_ASSERT_NULL(read_config("SO_PORTI=3\n" REQUIRED));
+	g = NULL;
+	TEST_ASSERT_NULL(read_config("SO_PORTI=32001\n" REQUIRED));
+	g = NULL;
+	TEST_ASSERT_NULL(read_config("SO_LATO=0.5\n" REQUIRED));
+	g = NULL;
+}
+
+void test_optional_out_of_range(void)
+{
+	TEST_ASSERT_NULL(read_config(REQUIRED "SO_SHARDS=5\n"));
+	g = NULL;
+	TEST_ASSERT_NULL(read_config(REQUIRED "SO_PIPELINE=2\n"));
+	g = NULL;
+	TEST_ASSERT_NULL(read_config(REQUIRED "SO_DAY_LAG=-2\n"));
+	g = NULL;
+}
+
+void test_not_integer(void)
+{
+	TEST_ASSERT_NULL(read_config(REQUIRED "SO_DOCK_WORKERS=1.5\n"));
+	g = NULL;
+}
+
+void test_missing_required(void)
+{
+	TEST_ASSERT_NULL(read_config("SO_LATO=1000.0\nSO_DAYS=3\n"));
+	g = NULL;
+}
+
+void test_unknown_and_duplicate(void)
+{
+	TEST_ASSERT_NULL(read_config(REQUIRED "SO_UNKNOWN=1\n"));
+	g = NULL;
+	TEST_ASSERT_NULL(read_config(REQUIRED "SO_NAVI=10\n"));
+	g = NULL;
+}
+
+void test_cross_checks(void)
+{
+	/* SO_MIN_VITA above SO_MAX_VITA */
+	TEST_ASSERT_NULL(read_config("1000.0\n3\n10\n500\n10\n4\n2\n1000\n200\n10\n1\n11\n10\n6\n24\n1\n"));
+	g = NULL;
+	/* SO_FILL below SO_DAYS */
+	TEST_ASSERT_NULL(read_config("1000.0\n3\n10\n500\n10\n4\n2\n2\n200\n10\n1\n3\n10\n6\n24\n1\n"));
+	g = NULL;
+}
+
+int main(void)
+{
+	int ns;
+
+	/* The segments of a test never meet the ones of a running simulation */
+	ns = ipc_claim_namespace(getpid(), 64);
+	if (ns == -1)
+		return EXIT_FAILURE;
+	ipc_set_namespace(ns);
+
+	UNITY_BEGIN();
+	RUN_TEST(test_optional_defaults);
+	RUN_TEST(test_keys_any_order);
+	RUN_TEST(test_positional_values);
+	RUN_TEST(test_required_out_of_range);
+	RUN_TEST(test_optional_out_of_range);
+	RUN_TEST(test_not_integer);
+	RUN_TEST(test_missing_required);
+	RUN_TEST(test_unknown_and_duplicate);
+	RUN_TEST(test_cross_checks);
+	ipc_release_namespace(ns);
+	return UNITY_END();
+}
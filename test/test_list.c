@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "../_src/header/_cargo_list.h"
+#include "../src/include/cargo_list.h"
 
 int main(int argc, char *argv[])
 {
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/include/utils.h"
+#include "../src/include/shm_general.h"
+#include "../src/include/shm_cargo.h"
+#include "../src/include/shm_offer_demand.h"
+#include "../src/include/cargo_list.h"
+#include "Unity/unity.h"
+
+/* 70 ports take two words of a port set */
+#define CONFIG \
+	"SO_LATO=1000.0\nSO_DAYS=10\nSO_NAVI=2\nSO_SPEED=500\nSO_CAPACITY=100\n" \
+	"SO_PORTI=70\nSO_BANCHINE=1\nSO_FILL=7000\nSO_LOADSPEED=200\nSO_MERCI=10\n" \
+	"SO_SIZE=5\nSO_MIN_VITA=5\nSO_MAX_VITA=10\nSO_STORM_DURATION=6\n" \
+	"SO_SWELL_DURATION=24\nSO_MAELSTROM=1\n"
+#define SPARSE CONFIG "SO_SPARSE_MAX=3\n"
+
+shm_general_t *g;
+shm_cargo_t *c;
+shm_offer_t *o;
+shm_demand_t *d;
+
+/**
+ * @brief Creates the segments of a configuration with an empty market.
+ */
+static void create_market(const char *text)
+{
+	char path[] = "/tmp/test_offer_demandXXXXXX";
+	int fd;
+
+	fd = mkstemp(path);
+	TEST_ASSERT_NOT_EQUAL(-1, fd);
+	TEST_ASSERT_EQUAL_INT((int)strlen(text), (int)write(fd, text, strlen(text)));
+	close(fd);
+	g = read_from_path(path, &g);
+	unlink(path);
+	TEST_ASSERT_NOT_NULL(g);
+	TEST_ASSERT_TRUE(shm_general_ipc_init(g));
+	c = shm_cargo_initialize(g);
+	o = shm_offer_init(g);
+	d = shm_demand_init(g, o);
+	TEST_ASSERT_NOT_NULL(c);
+	TEST_ASSERT_NOT_NULL(o);
+	TEST_ASSERT_NOT_NULL(d);
+}
+
+/**
+ * @brief Generates the offer and the demand of the first day at every port.
+ */
+static void generate_all(void)
+{
+	o_list_t **lists;
+	int port, type;
+
+	lists = malloc(sizeof(*lists) * get_merci(g));
+	TEST_ASSERT_NOT_NULL(lists);
+	for (type = 0; type < get_merci(g); type++)
+		lists[type] = cargo_list_create();
+	for (port = 0; port < get_porti(g); port++)
+		shm_offer_demand_generate(o, d, lists, port, c, g);
+	for (type = 0; type < get_merci(g); type++)
+		cargo_list_delete(lists[type]);
+	free(lists);
+}
+
+/**
+ * @brief Looks for a cargo type in the row of a port.
+ */
+static bool_t trades(int port, int type)
+{
+	int i;
+
+	for (i = 0; i < get_port_types(g); i++)
+		if (shm_offer_get_row_type(g, o, port, i) == type)
+			return TRUE;
+	return FALSE;
+}
+
+/**
+ * @brief Checks the bit of a port in a port set.
+ */
+static bool_t in_set(const unsigned long *set, int port)
+{
+	return (set[port / PORT_SET_BITS] >> (port % PORT_SET_BITS)) & 1UL ? TRUE : FALSE;
+}
+
+void setUp(void)
+{
+	g = NULL;
+}
+
+void tearDown(void)
+{
+	if (g == NULL)
+		return;
+	shm_general_ipc_delete(g);
+	shm_offer_demand_delete(g);
+	shm_cargo_delete(g);
+	shm_offer_detach(o);
+	shm_demand_detach(d);
+	shm_cargo_detach(c);
+	shm_general_delete(shm_general_get_id(g));
+	shm_general_detach(g);
+}
+
+void test_dense_rows(void)
+{
+	int port, i;
+
+	create_market(CONFIG);
+	TEST_ASSERT_EQUAL_INT(get_merci(g), get_port_types(g));
+	for (port = 0; port < get_porti(g); port++)
+		for (i = 0; i < get_port_types(g); i++) {
+			TEST_ASSERT_EQUAL_INT(i, shm_offer_get_row_type(g, o, port, i));
+			TEST_ASSERT_EQUAL_INT(i, shm_demand_get_row_type(g, d, port, i));
+		}
+	shm_offer_remove_quantity(o, g, 3, 7, -5);
+	TEST_ASSERT_EQUAL_INT(5, shm_offer_get_quantity(g, o, 3, 7));
+	TEST_ASSERT_EQUAL_INT(5, shm_offer_get_row_quantity(g, o, 3, 7));
+}
+
+void test_sparse_rows(void)
+{
+	int port, i;
+
+	create_market(SPARSE);
+	TEST_ASSERT_EQUAL_INT(3, get_port_types(g));
+	for (port = 0; port < get_porti(g); port++)
+		for (i = 0; i < get_port_types(g); i++) {
+			TEST_ASSERT_TRUE(shm_offer_get_row_type(g, o, port, i) >= 0);
+			TEST_ASSERT_TRUE(shm_offer_get_row_type(g, o, port, i) < get_merci(g));
+			/* Sorted without repetitions */
+			if (i > 0)
+				TEST_ASSERT_TRUE(shm_offer_get_row_type(g, o, port, i - 1)
+						 < shm_offer_get_row_type(g, o, port, i));
+			/* The demand mirrors the offer */
+			TEST_ASSERT_EQUAL_INT(shm_offer_get_row_type(g, o, port, i),
+					      shm_demand_get_row_type(g, d, port, i));
+		}
+}
+
+void test_sparse_lookup(void)
+{
+	int port, type, i;
+
+	create_market(SPARSE);
+	for (port = 0; port < get_porti(g); port++)
+		for (type = 0; type < get_merci(g); type++) {
+			shm_offer_remove_quantity(o, g, port, type, -(type + 1));
+			shm_demand_remove_quantity(d, g, port, type, -(type + 2));
+			if (trades(port, type)) {
+				TEST_ASSERT_EQUAL_INT(type + 1, shm_offer_get_quantity(g, o, port, type));
+				TEST_ASSERT_EQUAL_INT(type + 2, shm_demand_get_quantity(g, d, port, type));
+				TEST_ASSERT_EQUAL_INT(type + 2, shm_demand_get_available(g, d, port, type));
+			} else {
+				/* A type the port does not trade is ignored */
+				TEST_ASSERT_EQUAL_INT(0, shm_offer_get_quantity(g, o, port, type));
+				TEST_ASSERT_EQUAL_INT(0, shm_demand_get_quantity(g, d, port, type));
+				TEST_ASSERT_EQUAL_INT(0, shm_demand_get_available(g, d, port, type));
+			}
+		}
+	/* The row entries of the port hold what was added for their type */
+	for (i = 0; i < get_port_types(g); i++)
+		TEST_ASSERT_EQUAL_INT(shm_offer_get_row_type(g, o, 5, i) + 1, shm_offer_get_row_quantity(g, o, 5, i));
+}
+
+void test_inverted_index(void)
+{
+	int type, port, highest, n_ports;
+
+	create_market(SPARSE);
+	generate_all();
+	for (type = 0; type < get_merci(g); type++) {
+		n_ports = 0;
+		for (port = 0; port < get_porti(g); port++)
+			n_ports += trades(port, type);
+		/* Only the ports listed for the type are looked at */
+		highest = shm_offer_get_dump_highest(g, o, type);
+		TEST_ASSERT_TRUE(n_ports > 0 ? highest >= 0 && trades(highest, type) : highest == -1);
+		highest = shm_demand_get_dump_highest(g, d, type);
+		TEST_ASSERT_TRUE(n_ports > 0 ? highest >= 0 && trades(highest, type) : highest == -1);
+	}
+}
+
+void test_port_set_zero_crossings(void)
+{
+	const unsigned long *offer_set, *demand_set;
+	int port = PORT_SET_BITS + 1, word;
+
+	create_market(CONFIG);
+	offer_set = shm_offer_get_port_set(g, o, 4);
+	demand_set = shm_demand_get_port_set(g, d, 4);
+	TEST_ASSERT_EQUAL_INT(2, shm_offer_demand_get_set_words(g));
+	for (word = 0; word < shm_offer_demand_get_set_words(g); word++) {
+		TEST_ASSERT_TRUE(offer_set[word] == 0);
+		TEST_ASSERT_TRUE(demand_set[word] == 0);
+	}
+
+	shm_offer_remove_quantity(o, g, port, 4, -3);
+	TEST_ASSERT_TRUE(in_set(offer_set, port));
+	TEST_ASSERT_TRUE(offer_set[0] == 0);
+	shm_offer_remove_quantity(o, g, port, 4, -2);
+	shm_offer_remove_quantity(o, g, port, 4, 4);
+	TEST_ASSERT_TRUE(in_set(offer_set, port));
+	/* The neighbour in the same word keeps its bit */
+	shm_offer_remove_quantity(o, g, port - 1, 4, -1);
+	shm_offer_remove_quantity(o, g, port, 4, 1);
+	TEST_ASSERT_FALSE(in_set(offer_set, port));
+	TEST_ASSERT_TRUE(in_set(offer_set, port - 1));
+	/* Below zero and back, like a sale after a restore */
+	shm_offer_remove_quantity(o, g, port, 4, 2);
+	TEST_ASSERT_FALSE(in_set(offer_set, port));
+	shm_offer_remove_quantity(o, g, port, 4, -3);
+	TEST_ASSERT_TRUE(in_set(offer_set, port));
+
+	shm_demand_remove_quantity(d, g, 0, 4, -2);
+	TEST_ASSERT_TRUE(in_set(demand_set, 0));
+	shm_demand_remove_quantity(d, g, 0, 4, 1);
+	TEST_ASSERT_TRUE(in_set(demand_set, 0));
+	shm_demand_remove_quantity(d, g, 0, 4, 1);
+	TEST_ASSERT_FALSE(in_set(demand_set, 0));
+	/* The sets of the other types are untouched */
+	TEST_ASSERT_FALSE(in_set(shm_offer_get_port_set(g, o, 3), port));
+	TEST_ASSERT_TRUE(shm_demand_get_port_set(g, d, 5)[0] == 0);
+}
+
+void test_generated_port_sets(void)
+{
+	int port, type;
+
+	create_market(SPARSE);
+	generate_all();
+	for (type = 0; type < get_merci(g); type++)
+		for (port = 0; port < get_porti(g); port++) {
+			TEST_ASSERT_EQUAL_INT(shm_offer_get_quantity(g, o, port, type) > 0,
+					      in_set(shm_offer_get_port_set(g, o, type), port));
+			TEST_ASSERT_EQUAL_INT(shm_demand_get_quantity(g, d, port, type) > 0,
+					      in_set(shm_demand_get_port_set(g, d, type), port));
+		}
+}
+
+int main(void)
+{
+	int ns;
+
+	/* The segments of a test never meet the ones of a running simulation */
+	ns = ipc_claim_namespace(getpid(), 64);
+	if (ns == -1)
+		return EXIT_FAILURE;
+	ipc_set_namespace(ns);
+	srandom(1);
+
+	UNITY_BEGIN();
+	RUN_TEST(test_dense_rows);
+	RUN_TEST(test_sparse_rows);
+	RUN_TEST(test_sparse_lookup);
+	RUN_TEST(test_inverted_index);
+	RUN_TEST(test_port_set_zero_crossings);
+	RUN_TEST(test_generated_port_sets);
+	ipc_release_namespace(ns);
+	return UNITY_END();
+}
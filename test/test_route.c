@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lib/semaphore.h"
+#include "../src/include/utils.h"
+#include "../src/include/shm_general.h"
+#include "../src/include/shm_port.h"
+#include "../src/include/shm_cargo.h"
+#include "../src/include/shm_offer_demand.h"
+#include "../src/include/cargo_list.h"
+#include "../src/include/route.h"
+#include "Unity/unity.h"
+
+/* Four ports and three cargo types of size 1, a day every 500 units */
+#define CONFIG \
+	"SO_LATO=1000.0\nSO_DAYS=30\nSO_NAVI=1\nSO_SPEED=500\nSO_CAPACITY=100\n" \
+	"SO_PORTI=4\nSO_BANCHINE=1\nSO_FILL=1000\nSO_LOADSPEED=200\nSO_MERCI=3\n" \
+	"SO_SIZE=1\nSO_MIN_VITA=5\nSO_MAX_VITA=10\nSO_STORM_DURATION=6\n" \
+	"SO_SWELL_DURATION=24\nSO_MAELSTROM=1\n"
+
+#define FREE_TONS 100
+
+shm_general_t *g;
+shm_port_t *p;
+shm_cargo_t *c;
+shm_offer_t *o;
+shm_demand_t *d;
+o_list_t *hold[3];
+
+/**
+ * @brief Creates the segments of a configuration with an empty market and
+ * 	the ports placed at (0, 0), (100, 0), (0, 300) and (0, 400).
+ */
+static void create_market(const char *text)
+{
+	char path[] = "/tmp/test_routeXXXXXX";
+	struct coord coord;
+	int fd, i;
+
+	fd = mkstemp(path);
+	TEST_ASSERT_NOT_EQUAL(-1, fd);
+	TEST_ASSERT_EQUAL_INT((int)strlen(text), (int)write(fd, text, strlen(text)));
+	close(fd);
+	g = read_from_path(path, &g);
+	unlink(path);
+	TEST_ASSERT_NOT_NULL(g);
+	TEST_ASSERT_TRUE(shm_general_ipc_init(g));
+	p = shm_port_initialize(g);
+	TEST_ASSERT_NOT_NULL(p);
+	TEST_ASSERT_TRUE(shm_port_ipc_init(g, p));
+	c = shm_cargo_initialize(g);
+	o = shm_offer_init(g);
+	d = shm_demand_init(g, o);
+	TEST_ASSERT_NOT_NULL(c);
+	TEST_ASSERT_NOT_NULL(o);
+	TEST_ASSERT_NOT_NULL(d);
+
+	for (i = 0; i < get_porti(g); i++) {
+		coord.x = i == 1 ? 100 : 0;
+		coord.y = i < 2 ? 0 : 100 * (i + 1);
+		shm_port_set_coordinates(p, i, coord);
+	}
+}
+
+/**
+ * @brief Adds demand to a port, a negative removal like a restore does.
+ */
+static void add_demand(int port, int type, int quantity)
+{
+	shm_demand_remove_quantity(d, g, port, type, -quantity);
+}
+
+static void add_offer(int port, int type, int quantity)
+{
+	shm_offer_remove_quantity(o, g, port, type, -quantity);
+}
+
+static int plan(int free_tons, int curr_port_id)
+{
+	return route_plan(g, p, o, d, c, hold, free_tons, shm_port_get_coordinates(p, curr_port_id), curr_port_id);
+}
+
+void setUp(void)
+{
+	int i;
+
+	g = NULL;
+	for (i = 0; i < 3; i++)
+		hold[i] = cargo_list_create();
+}
+
+void tearDown(void)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		cargo_list_delete(hold[i]);
+	route_plan_destroy();
+	if (g == NULL)
+		return;
+	shm_general_ipc_delete(g);
+	sem_delete(shm_port_get_sem_docks_id(p));
+	shm_port_delete(g);
+	shm_offer_demand_delete(g);
+	shm_cargo_delete(g);
+	shm_port_detach(p);
+	shm_offer_detach(o);
+	shm_demand_detach(d);
+	shm_cargo_detach(c);
+	shm_general_delete(shm_general_get_id(g));
+	shm_general_detach(g);
+}
+
+void test_travel_time(void)
+{
+	struct coord from = {0, 0}, to = {300, 400};
+
+	create_market(CONFIG);
+	TEST_ASSERT_EQUAL_DOUBLE(1.0, route_get_travel_time(g, from, to));
+	TEST_ASSERT_EQUAL_DOUBLE(0.0, route_get_travel_time(g, to, to));
+}
+
+void test_shard(void)
+{
+	struct coord first = {0, 0}, right = {999, 10}, corner = {1000, 1000};
+
+	create_market(CONFIG);
+	TEST_ASSERT_EQUAL_INT(0, route_get_shard(g, corner));
+	tearDown();
+	setUp();
+
+	create_market(CONFIG "SO_SHARDS=2\n");
+	TEST_ASSERT_EQUAL_INT(0, route_get_shard(g, first));
+	TEST_ASSERT_EQUAL_INT(1, route_get_shard(g, right));
+	/* The edges belong to the last regions */
+	TEST_ASSERT_EQUAL_INT(3, route_get_shard(g, corner));
+}
+
+void test_most_demand(void)
+{
+	create_market(CONFIG);
+	cargo_list_add(hold[0], 10, 20);
+	add_demand(1, 0, 2);
+	add_demand(2, 0, 10);
+	TEST_ASSERT_EQUAL_INT(2, plan(FREE_TONS, 0));
+	TEST_ASSERT_EQUAL_INT(2, route_find_best_port(g, p, d, hold, shm_port_get_coordinates(p, 0), 0));
+}
+
+void test_skips_current_port(void)
+{
+	create_market(CONFIG);
+	cargo_list_add(hold[0], 10, 20);
+	add_demand(1, 0, 2);
+	add_demand(2, 0, 10);
+	TEST_ASSERT_EQUAL_INT(1, plan(FREE_TONS, 2));
+	TEST_ASSERT_EQUAL_INT(1, route_find_best_port(g, p, d, hold, shm_port_get_coordinates(p, 2), 2));
+}
+
+void test_expired_hold(void)
+{
+	struct coord far = {0, 600};
+
+	create_market(CONFIG);
+	/* The lots expire before reaching port 2, a day away, not port 1 */
+	shm_port_set_coordinates(p, 2, far);
+	cargo_list_add(hold[0], 10, 1);
+	add_demand(1, 0, 2);
+	add_demand(2, 0, 10);
+	TEST_ASSERT_EQUAL_INT(1, plan(FREE_TONS, 0));
+}
+
+void test_no_candidates(void)
+{
+	create_market(CONFIG);
+	/* Nothing to trade anywhere: the closest port */
+	TEST_ASSERT_EQUAL_INT(1, plan(FREE_TONS, 0));
+}
+
+void test_second_hop(void)
+{
+	create_market(CONFIG);
+	cargo_list_add(hold[0], 6, 20);
+	cargo_list_add(hold[1], 10, 20);
+	/* Port 1 buys the most, but port 2 sells what port 3 next to it buys */
+	add_demand(1, 0, 6);
+	add_demand(2, 1, 5);
+	add_offer(2, 2, 20);
+	add_demand(3, 0, 6);
+	add_demand(3, 2, 20);
+	TEST_ASSERT_EQUAL_INT(1, route_find_best_port(g, p, d, hold, shm_port_get_coordinates(p, 0), 0));
+	TEST_ASSERT_EQUAL_INT(2, plan(FREE_TONS, 0));
+}
+
+void test_cache(void)
+{
+	create_market(CONFIG);
+	cargo_list_add(hold[0], 10, 20);
+	add_demand(1, 0, 2);
+	add_demand(2, 0, 10);
+	TEST_ASSERT_EQUAL_INT(2, plan(FREE_TONS, 0));
+
+	/* Same port, day and hold: the demand is not looked at again */
+	add_demand(2, 0, -10);
+	TEST_ASSERT_EQUAL_INT(2, plan(FREE_TONS, 0));
+	/* A different free capacity misses the cache */
+	TEST_ASSERT_EQUAL_INT(1, plan(FREE_TONS - 1, 0));
+
+	/* So does a different hold */
+	cargo_list_add(hold[1], 1, 20);
+	TEST_ASSERT_EQUAL_INT(1, plan(FREE_TONS, 0));
+	/* And a new day */
+	add_demand(2, 0, 10);
+	TEST_ASSERT_EQUAL_INT(1, plan(FREE_TONS, 0));
+	increase_day(g);
+	TEST_ASSERT_EQUAL_INT(2, plan(FREE_TONS, 0));
+}
+
+int main(void)
+{
+	int ns;
+
+	/* The segments of a test never meet the ones of a running simulation */
+	ns = ipc_claim_namespace(getpid(), 64);
+	if (ns == -1)
+		return EXIT_FAILURE;
+	ipc_set_namespace(ns);
+
+	UNITY_BEGIN();
+	RUN_TEST(test_travel_time);
+	RUN_TEST(test_shard);
+	RUN_TEST(test_most_demand);
+	RUN_TEST(test_skips_current_port);
+	RUN_TEST(test_expired_hold);
+	RUN_TEST(test_no_candidates);
+	RUN_TEST(test_second_hop);
+	RUN_TEST(test_cache);
+	ipc_release_namespace(ns);
+	return UNITY_END();
+}
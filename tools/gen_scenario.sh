@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Generates the header of a specialized build from a configuration file:
+# every constant becomes a compile time value and the getters of
+# src/include/shm_general.h become macros when SO_SCENARIO is defined.
+#
+# Usage: gen_scenario.sh <configuration> > src/include/scenario.h
+
+if [ $# -ne 1 ] || [ ! -r "$1" ]; then
+	echo "Usage: $0 <configuration>" >&2
+	exit 1
+fi
+
+NAMES="SO_LATO SO_DAYS SO_NAVI SO_SPEED SO_CAPACITY SO_PORTI SO_BANCHINE SO_FILL \
+SO_LOADSPEED SO_MERCI SO_SIZE SO_MIN_VITA SO_MAX_VITA SO_STORM_DURATION \
+SO_SWELL_DURATION SO_MAELSTROM"
+# Optional constants and their default
+OPTIONAL="SO_DAY_LAG=-1 SO_DOCK_WORKERS=0 SO_PIPELINE=0 SO_SPARSE_MAX=0 SO_SHARDS=0"
+
+awk -v names="$NAMES" -v optional="$OPTIONAL" -v source="$1" '
+BEGIN {
+	n = split(names, name, " ")
+	n_optional = split(optional, opt, " ")
+	for (i = 1; i <= n_optional; i++) {
+		split(opt[i], kv, "=")
+		name[n + i] = kv[1]
+		def[n + i] = kv[2]
+	}
+	required = n
+	n += n_optional
+	for (i = 1; i <= n; i++)
+		index_of[name[i]] = i
+}
+{ sub(/#.*/, "") }
+NF == 0 { next }
+/=/ {
+	key = substr($0, 1, index($0, "=") - 1)
+	gsub(/[ \t\r]/, "", key)
+	if (!(key in index_of))
+		exit 1
+	i = index_of[key]
+	split(substr($0, index($0, "=") + 1), v, " ")
+	value[i] = v[1]
+	next
+}
+{
+	if (++positional > n)
+		exit 1
+	value[positional] = $1
+}
+END {
+	for (i = 1; i <= n; i++) {
+		if (value[i] == "" && i > required)
+			value[i] = def[i]
+		if (value[i] == "") {
+			print source ": " name[i] " is missing" > "/dev/stderr"
+			exit 1
+		}
+	}
+	print "/* Generated by tools/gen_scenario.sh from " source ", do not edit. */"
+	print "#ifndef OS_PROJECT_SCENARIO_H"
+	print "#define OS_PROJECT_SCENARIO_H"
+	print ""
+	for (i = 1; i <= n; i++)
+		printf "#define %s_VALUE %s\n", name[i], value[i]
+	print ""
+	print "#endif"
+}' "$1"